@@ -1,12 +1,39 @@
 #ifndef AWEEK_C_ANIME_FUNCTIONS_H
 #define AWEEK_C_ANIME_FUNCTIONS_H
+#define ANIME_UID_LENGTH 16 // hex digits
 enum ADD_ANIME_METHOD { //TODO MAL url parsing
     MANUAL,
+    MAL_EXPORT, // MyAnimeList xml export file
+    ANILIST_EXPORT, // AniList json export file
 };
-int list_all(struct json_object * anime_array);
+enum LIST_SORT {
+    SORT_NONE, // file order
+    SORT_NAME,
+    SORT_NEXT_AIRING,
+    SORT_REMAINING, // episodes left to download
+    SORT_START,
+};
+enum LIST_FILTER { // can be combined, all have to match
+    FILTER_AIRING = 1 << 0,
+    FILTER_FINISHED = 1 << 1,
+    FILTER_IGNORED = 1 << 2,
+    FILTER_HAS_NEW = 1 << 3,
+};
+struct list_options {
+    enum LIST_SORT sort;
+    int filter; // LIST_FILTER flags
+    size_t limit; // 0 means no limit
+    size_t offset;
+};
+int list_all(struct json_object * anime_array, const struct list_options * options);
+int get_aired_episodes_count(struct json_object * anime, time_t now);
+int get_new_episodes_count(struct json_object * anime_array, size_t anime_at);
 int print_new_episodes(struct json_object * anime_array);
 int print_new_episodes_count(struct json_object * anime_array);
-int add_anime(struct json_object * anime_array, enum ADD_ANIME_METHOD method);
+int make_anime_uid(char * uid);
+int touch_anime_field(struct json_object * anime, const char * field);
+struct json_object * make_anime_json_object(char * name, size_t episodes, time_t start_date);
+int add_anime(struct json_object * anime_array, enum ADD_ANIME_METHOD method, const char * source);
 int edit_anime(struct json_object * anime);
 int delete_anime(struct json_object * anime_array, size_t delete_at);
 int update_anime(struct json_object * anime, size_t downloaded_episodes);
@@ -0,0 +1,41 @@
+#ifndef AWEEK_C_HISTORY_H
+#define AWEEK_C_HISTORY_H
+#define HISTORY_FILENAME "history.bin" // relative to the app subfolder, download events ordered by time
+#define HISTORY_WEEKS_FILENAME "history-weeks.bin" // relative to the app subfolder, weekly rollups of download events
+#define HISTORY_ANIME_FILENAME "history-anime.bin" // relative to the app subfolder, per anime rollups of download events
+// History files are in native byte order, they are local to the machine and never synchronized
+struct history_event {
+    int64_t time;           // when the episodes were downloaded, never decreases along the file
+    uint64_t anime;         // anime key, its uid as a number, or a hash of its name for anime without one
+    uint32_t from, to;      // downloaded episodes count before and after
+    uint32_t lag_episodes;  // downloaded episodes that had already aired
+    uint32_t reserved;
+    int64_t lag;            // total seconds from airing to downloading over lag_episodes
+};
+struct history_week {
+    int64_t lag;
+    uint32_t episodes;
+    uint32_t lag_episodes;
+    uint32_t events;
+    uint32_t backlog;       // new episodes left after the last download of the week
+};
+struct history_anime {
+    uint64_t anime;         // anime key as in history_event, 0 for a free slot
+    int64_t lag;
+    int64_t last;           // time of the last download
+    uint32_t episodes;
+    uint32_t lag_episodes;
+};
+struct history_totals {
+    int64_t first_week;     // index of the first week in the weeks file
+    int64_t lag;
+    uint64_t episodes;
+    uint64_t lag_episodes;
+    uint64_t events;
+};
+int history_record(struct json_object * anime, size_t from, size_t to, time_t now);
+int history_flush(int dir_fd, struct json_object * anime_array);
+void history_discard();
+int print_stats(int dir_fd, int range, time_t from, time_t to);
+int print_anime_stats(int dir_fd, struct json_object * anime);
+#endif //AWEEK_C_HISTORY_H
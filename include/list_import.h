@@ -0,0 +1,6 @@
+#ifndef AWEEK_C_LIST_IMPORT_H
+#define AWEEK_C_LIST_IMPORT_H
+int detect_export_method(const char * filepath, enum ADD_ANIME_METHOD * method);
+int add_anime_from_mal_export(struct json_object * anime_array, const char * filepath);
+int add_anime_from_anilist_export(struct json_object * anime_array, const char * filepath);
+#endif //AWEEK_C_LIST_IMPORT_H
@@ -0,0 +1,37 @@
+#ifndef AWEEK_C_PROBES_H
+#define AWEEK_C_PROBES_H
+// USDT probes for perf and bpftrace, see scripts/phases.bt
+// With sys/sdt.h each probe is a single nop until a tracer attaches, without it probes and their arguments compile away
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define AWEEK_PROBES
+#endif
+#endif
+
+#ifdef AWEEK_PROBES
+#define PROBE0(name) DTRACE_PROBE(aweek, name)
+#define PROBE1(name, a) DTRACE_PROBE1(aweek, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(aweek, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(aweek, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(aweek, name, a, b, c, d)
+// Probe arguments are evaluated even with no tracer attached, costly ones are only computed if PROBE_ENABLED()
+// Tracers attaching to a probe increment its semaphore, semaphores are defined in main.c
+#define PROBE_SEMAPHORE(name) unsigned short aweek_##name##_semaphore __attribute__((section(".probes")))
+#define PROBE_ENABLED(name) __builtin_expect(aweek_##name##_semaphore != 0, 0)
+extern unsigned short aweek_dispatch__start_semaphore, aweek_dispatch__done_semaphore;
+extern unsigned short aweek_load__start_semaphore, aweek_load__done_semaphore;
+extern unsigned short aweek_parse__start_semaphore, aweek_parse__done_semaphore;
+extern unsigned short aweek_new_episodes__start_semaphore, aweek_new_episodes__done_semaphore;
+extern unsigned short aweek_list__start_semaphore, aweek_list__done_semaphore;
+extern unsigned short aweek_save__start_semaphore, aweek_save__done_semaphore;
+#else
+#define PROBE0(name) do {} while (0)
+#define PROBE1(name, a) do {} while (0)
+#define PROBE2(name, a, b) do {} while (0)
+#define PROBE3(name, a, b, c) do {} while (0)
+#define PROBE4(name, a, b, c, d) do {} while (0)
+#define PROBE_ENABLED(name) 0
+#endif
+#endif //AWEEK_C_PROBES_H
@@ -0,0 +1,50 @@
+#ifndef AWEEK_C_QUERY_H
+#define AWEEK_C_QUERY_H
+enum QUERY_OP {
+    QUERY_FIELD,            // push an anime field, e.g. episodes
+    QUERY_NUMBER,           // push a number literal
+    QUERY_STRING,           // push a string literal, "..." or '...'
+    QUERY_BOOLEAN,          // push true or false
+    QUERY_NOT,              // !
+    QUERY_AND,              // &&
+    QUERY_OR,               // ||
+    QUERY_EQ,               // ==
+    QUERY_NE,               // !=
+    QUERY_LT,               // <
+    QUERY_LE,               // <=
+    QUERY_GT,               // >
+    QUERY_GE,               // >=
+    QUERY_OPEN,             // (, only used while compiling
+};
+enum QUERY_FIELD {
+    QUERY_FIELD_NAME,
+    QUERY_FIELD_EPISODES,
+    QUERY_FIELD_DOWNLOADED, // episodes_downloaded
+    QUERY_FIELD_START_DATE,
+    QUERY_FIELD_DELAYED,    // delayed_episodes, can only be set
+    QUERY_FIELD_IGNORED,
+    QUERY_FIELD_AIRED,      // aired episodes, can only be queried
+    QUERY_FIELD_NEW,        // new episodes, can only be queried
+};
+struct query_op {
+    enum QUERY_OP op;
+    enum QUERY_FIELD field;
+    int64_t number;         // QUERY_NUMBER and QUERY_BOOLEAN value
+    size_t offset, length;  // QUERY_STRING: literal position in the query source
+};
+struct query_value {
+    int64_t number;
+    const char * string;
+    size_t length;
+};
+struct query {
+    char * source;
+    struct query_value * stack; // evaluation stack, deep enough for every op
+    size_t n_ops;
+    struct query_op ops[];
+};
+struct query * query_compile(const char * source);
+void query_free(struct query * query);
+int query_match(const struct query * query, struct json_object * anime, time_t now);
+int set_anime(struct json_object * anime_array, const struct query * where, int n_assignments, char ** assignments);
+#endif //AWEEK_C_QUERY_H
@@ -0,0 +1,16 @@
+#ifndef AWEEK_C_STORAGE_H
+#define AWEEK_C_STORAGE_H
+enum STORAGE_ENCODING {
+    STORAGE_JSON,
+    STORAGE_CBOR, // RFC 8949, prefixed with the self-describe tag used as magic bytes
+};
+struct storage_format {
+    enum STORAGE_ENCODING encoding;
+    int compressed; // gzip, detected by its magic bytes
+};
+int parse_storage_format(const char * name, struct storage_format * format);
+gzFile storage_open_read(int dir_fd, const char * filepath);
+gzFile storage_open_write(int dir_fd, const char * filepath, struct storage_format format);
+struct json_object * storage_read(gzFile file, struct storage_format * format);
+int storage_write(gzFile file, struct json_object * anime_array, struct storage_format format);
+#endif //AWEEK_C_STORAGE_H
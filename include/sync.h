@@ -0,0 +1,11 @@
+#ifndef AWEEK_C_SYNC_H
+#define AWEEK_C_SYNC_H
+#define SYNC_ID_FILENAME "sync-id" // relative to the app subfolder, identifies the folder to its peers
+#define SYNC_BASE_FILENAME "sync-base-%s.json" // relative to the app subfolder, last state synchronized with a peer
+struct sync_changes {
+    size_t added, updated, removed;
+};
+int sync_assign_uids(struct json_object * local_array, struct json_object * other_array, size_t * local_assigned, size_t * other_assigned);
+struct json_object * sync_merge(struct json_object * base_array, struct json_object * local_array, struct json_object * other_array,
+                                struct sync_changes * local_changes, struct sync_changes * other_changes);
+#endif //AWEEK_C_SYNC_H
@@ -0,0 +1,34 @@
+#ifndef AWEEK_C_TEMPLATE_H
+#define AWEEK_C_TEMPLATE_H
+enum TEMPLATE_OP {
+    TEMPLATE_TEXT,          // literal text, copied as is
+    TEMPLATE_FIELD,         // placeholder, e.g. {name}
+    TEMPLATE_ITEMS_BEGIN,   // {#items}, repeated for every new episode
+    TEMPLATE_EMPTY_BEGIN,   // {^items}, rendered only if there are no new episodes
+    TEMPLATE_SECTION_END,   // {/items}
+};
+enum TEMPLATE_FIELD {
+    FIELD_COUNT,            // total number of new episodes
+    FIELD_ANIME,            // number of anime with new episodes
+    FIELD_ID,               // anime id, as used by other commands
+    FIELD_NAME,             // anime name
+    FIELD_EPISODE,          // new episode number
+    FIELD_NEW,              // number of new episodes for the anime
+    FIELD_DOWNLOADED,       // downloaded episodes count of the anime
+    FIELD_EPISODES,         // episodes count of the anime
+};
+struct template_op {
+    enum TEMPLATE_OP op;
+    enum TEMPLATE_FIELD field;
+    size_t offset, length;  // TEMPLATE_TEXT: literal position in the template source
+    size_t end;             // section begin ops: index of the matching TEMPLATE_SECTION_END
+};
+struct template {
+    char * source;
+    size_t n_ops;
+    struct template_op ops[];
+};
+struct template * template_compile(const char * source);
+void template_free(struct template * tmpl);
+int print_template(const struct template * tmpl, struct json_object * anime_array);
+#endif //AWEEK_C_TEMPLATE_H
@@ -0,0 +1,7 @@
+#ifndef AWEEK_C_UTF8_H
+#define AWEEK_C_UTF8_H
+size_t utf8_printable_prefix(const char * s, size_t length);
+size_t utf8_decode(const char * s, size_t length, uint32_t * codepoint);
+int utf8_codepoint_width(uint32_t codepoint);
+size_t utf8_print_column(FILE * stream, const char * s, size_t length, size_t columns);
+#endif //AWEEK_C_UTF8_H
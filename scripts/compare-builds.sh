@@ -0,0 +1,49 @@
+#!/bin/sh
+# Build aweek in release, lto and pgo modes and report per command latency deltas against release.
+# Usage: scripts/compare-builds.sh, from the repository root
+# The workload runs ROUNDS times per build, the median latency of every command is reported.
+set -e
+
+ROUNDS=${ROUNDS:-5}
+
+OUTDIR=$(mktemp -d)
+trap 'rm -rf "$OUTDIR"' EXIT
+
+for mode in release lto pgo; do
+	if [ "$mode" = release ]; then
+		make clean >/dev/null
+		DEBUG=false make >/dev/null
+	else
+		make "$mode" >/dev/null
+	fi
+	cp bin/aweek "$OUTDIR/aweek-$mode"
+done
+make clean >/dev/null
+
+# builds take turns every round, so machine load drifting over time skews all of them alike
+round=1
+while [ $round -le "$ROUNDS" ]; do
+	for mode in release lto pgo; do
+		scripts/workload.sh "$OUTDIR/aweek-$mode" --time >"$OUTDIR/$mode.$round.tsv"
+	done
+	round=$((round + 1))
+done
+
+# median latency of every command over the rounds
+for mode in release lto pgo; do
+	cat "$OUTDIR/$mode".*.tsv | awk -F '\t' '
+		{ key = $1 "\t" $2; if (!(key in count)) order[rows++] = key; latency[key, count[key]++] = $3 }
+		END {
+			for (r = 0; r < rows; r++) {
+				key = order[r];
+				n = count[key];
+				for (i = 0; i < n; i++) sorted[i] = latency[key, i];
+				for (i = 1; i < n; i++) for (j = i; j > 0 && sorted[j - 1] > sorted[j]; j--) { t = sorted[j]; sorted[j] = sorted[j - 1]; sorted[j - 1] = t; }
+				printf "%s\t%d\n", key, n % 2 ? sorted[int(n / 2)] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+			}
+		}' >"$OUTDIR/$mode.tsv"
+done
+
+paste "$OUTDIR/release.tsv" "$OUTDIR/lto.tsv" "$OUTDIR/pgo.tsv" | awk -F '\t' '
+	BEGIN { printf "%-8s %-16s %10s %10s %8s %10s %8s\n", "entries", "command", "release_us", "lto_us", "lto", "pgo_us", "pgo" }
+	{ printf "%-8s %-16s %10d %10d %+7.1f%% %10d %+7.1f%%\n", $1, $2, $3, $6, ($6 - $3) * 100 / $3, $9, ($9 - $3) * 100 / $3 }'
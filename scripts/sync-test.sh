@@ -0,0 +1,117 @@
+#!/bin/sh
+# Tests of aweek sync, with local folders standing in for the machines.
+# Usage: scripts/sync-test.sh <aweek binary>
+set -e
+
+AWEEK=$(realpath "$1")
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+NOW=$(date +%s)
+FAILED=0
+
+# on <machine> <args...>: runs aweek on a machine, every machine has its own config folder
+on() {
+	machine=$1
+	shift
+	XDG_CONFIG_HOME="$WORKDIR/$machine" "$AWEEK" "$@"
+}
+
+# sync_with <machine> <other machine>
+sync_with() {
+	on "$1" sync "$WORKDIR/$2/aweek" >"$WORKDIR/sync.log"
+}
+
+# anime <machine> [list options...]: prints "name downloaded/episodes" for every anime, in order
+anime() {
+	machine=$1
+	shift
+	on "$machine" l "$@" | awk -F ' [|] ' 'NR > 2 && NF == 4 { sub(/ +$/, "", $2); gsub(/ /, "", $3); print $2 " " $3 }'
+}
+
+# check <description> <expected> <actual>
+check() {
+	if [ "$2" = "$3" ]; then
+		printf "ok   %s\n" "$1"
+	else
+		printf "FAIL %s\nexpected:\n%s\nactual:\n%s\n" "$1" "$2" "$3"
+		FAILED=1
+	fi
+}
+
+# legacy <machine> <name:downloaded:episodes:ignored>...: writes an anime file from before ids and versions existed
+legacy() {
+	mkdir -p "$WORKDIR/$1/aweek"
+	file="$WORKDIR/$1/aweek/anime.json"
+	shift
+	separator="["
+	for entry in "$@"; do
+		echo "$entry" | awk -F : -v start=$((NOW - 10 * 7 * 86400)) -v separator="$separator" '{
+			printf "%s\n{ \"name\": \"%s\", \"episodes\": %d, \"episodes_downloaded\": %d, \"start_date\": %d, \"delayed_episodes\": [ ], \"ignored\": %s }",
+				   separator, $1, $3, $2, start, $4
+		}'
+		separator=","
+	done >"$file"
+	echo "]" >>"$file"
+}
+
+# anime saved before ids existed are matched by name, the first sync gives them ids on both sides
+legacy a "Frieren:3:28:false" "Dungeon Meshi:24:24:false"
+legacy b "Frieren:5:28:false" "Apothecary:1:24:false"
+sync_with a b
+expected="Frieren 5/28
+Dungeon Meshi 24/24
+Apothecary 1/24"
+check "legacy files: merged locally" "$expected" "$(anime a)"
+check "legacy files: merged on the other side" "$expected" "$(anime b)"
+check "legacy files: ids assigned on both sides" "3 3" "$(grep -c '"uid"' "$WORKDIR/a/aweek/anime.json") $(grep -c '"uid"' "$WORKDIR/b/aweek/anime.json")"
+sync_with b a
+check "legacy files: nothing left to merge" "Pulled 0 added, 0 updated and 0 removed anime
+Pushed 0 added, 0 updated and 0 removed anime" "$(cat "$WORKDIR/sync.log")"
+
+# an update on one side and an ignore toggle on the other both survive
+on a u 1 7 >/dev/null
+on b i 1 >/dev/null
+sync_with a b
+check "update vs ignore: downloaded episodes taken from the update" "Frieren 7/28" "$(anime b | head -n 1)"
+check "update vs ignore: ignored taken from the toggle" "Frieren 7/28" "$(anime a --filter=ignored)"
+check "update vs ignore: both sides equal" "$(anime a)" "$(anime b)"
+
+# the bigger downloaded episodes count wins when both sides update
+on a u 3 4 >/dev/null
+on b u 3 2 >/dev/null
+sync_with b a
+check "update vs update: bigger downloaded episodes count wins" "Apothecary 4/24" "$(anime b | tail -n 1)"
+
+# an anime removed on one side stays if the other side changed it since, and goes if it did not
+on a d 2 >/dev/null
+on b set --where 'name == "Dungeon Meshi"' episodes=25 >/dev/null
+on b d 3 >/dev/null
+sync_with a b
+expected="Frieren 7/28
+Dungeon Meshi 24/25"
+check "removal vs edit: edited anime kept, unchanged anime removed" "$expected" "$(anime a)"
+check "removal vs edit: both sides equal" "$expected" "$(anime b)"
+
+# a machine without any anime gets everything
+mkdir -p "$WORKDIR/c/aweek"
+sync_with a c
+check "new empty peer: pushed everything" "Pulled 0 added, 0 updated and 0 removed anime
+Pushed 2 added, 0 updated and 0 removed anime" "$(cat "$WORKDIR/sync.log")"
+check "new empty peer: both sides equal" "$expected" "$(anime c)"
+
+# every side keeps its own storage format
+mkdir -p "$WORKDIR/d/aweek"
+on a export "$WORKDIR/d.cbor.gz" cbor.gz
+on d import "$WORKDIR/d.cbor.gz" >/dev/null
+sleep 1 # versions have a one second resolution, the sides never synchronized, so the newer edit has to win
+on d set --where 'name == "Dungeon Meshi"' episodes=26 >/dev/null
+sync_with a d
+check "cbor.gz peer: edit pulled" "Dungeon Meshi 24/26" "$(anime a | tail -n 1)"
+on a u 1 8 >/dev/null
+sync_with a d
+check "cbor.gz peer: update pushed" "Frieren 8/28" "$(anime d | head -n 1)"
+check "cbor.gz peer: stays gzip compressed" "1f8b" "$(od -A n -t x1 -N 2 "$WORKDIR/d/aweek/anime.json" | tr -d ' ')"
+check "cbor.gz peer: local side stays json" "[" "$(head -c 1 "$WORKDIR/a/aweek/anime.json")"
+
+exit $FAILED
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Startup syscall budget of read-only commands, fails if it regresses.
+# Only syscalls from opening the config folder on are checked, the dynamic loader's are left out.
+# Usage: scripts/syscalls.sh <aweek binary>, needs strace (set STRACE to use another one)
+set -e
+
+AWEEK=$(realpath "$1")
+STRACE=${STRACE:-strace}
+OPEN_BUDGET=2 # open(folder, O_PATH) and openat(folder, anime.json)
+SYSCALL_BUDGET=${SYSCALL_BUDGET:-15} # every syscall from opening the folder to exiting for `aweek n`, as measured on x86-64 glibc
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+export XDG_CONFIG_HOME="$WORKDIR"
+FOLDER="$WORKDIR/aweek"
+FAILED=0
+
+# trace <args...>: runs aweek under strace, keeping only the syscalls from opening the config folder on
+trace() {
+	"$STRACE" -f -o "$WORKDIR/trace.log" "$AWEEK" "$@" >/dev/null
+	sed -n "\\|\"$FOLDER|,\$p" "$WORKDIR/trace.log" | grep '^[0-9]* *[a-z_0-9]*(' >"$WORKDIR/startup.log" || true
+	if [ ! -s "$WORKDIR/startup.log" ]; then
+		echo "aweek $* never opened $FOLDER" >&2
+		exit 1
+	fi
+}
+
+# check <description> <count> <budget>
+check() {
+	if [ "$2" -gt "$3" ]; then
+		printf "FAIL %s: %d, budget %d\n" "$1" "$2" "$3"
+		FAILED=1
+	else
+		printf "ok   %s: %d, budget %d\n" "$1" "$2" "$3"
+	fi
+}
+
+# opens and probes (stat, access, mkdir) of the config folder or the anime file
+count_config() {
+	grep -E "$1\\(" "$WORKDIR/startup.log" | grep -c -E "\"($FOLDER|$FOLDER/anime\\.json|anime\\.json)\"" || true
+}
+
+mkdir -p "$FOLDER"
+cat >"$FOLDER/anime.json" <<JSON
+[
+  { "name": "Anime", "episodes": 12, "episodes_downloaded": 1, "start_date": $(( $(date +%s) - 3 * 7 * 86400 )), "delayed_episodes": [ ], "ignored": false }
+]
+JSON
+
+for command in "" n l v; do
+	trace $command
+	check "aweek $command opens" "$(count_config '(open|openat)')" $OPEN_BUDGET
+	check "aweek $command probes" "$(count_config '(stat|lstat|newfstatat|statx|access|faccessat|faccessat2|mkdir|mkdirat)')" 0
+done
+trace n
+check "aweek n syscalls" "$(wc -l <"$WORKDIR/startup.log")" "$SYSCALL_BUDGET"
+
+# a missing folder reads as an empty list, without being created
+rm -rf "$FOLDER"
+trace n
+check "aweek n opens without a folder" "$(count_config '(open|openat)')" 1
+check "aweek n creates the folder" "$([ -e "$FOLDER" ] && echo 1 || echo 0)" 0
+
+exit $FAILED
@@ -0,0 +1,104 @@
+#!/bin/sh
+# Representative aweek workload, used to train PGO builds and to compare build modes.
+# Usage: scripts/workload.sh <aweek binary> [--time|--storage]
+# With --time, the mean latency of every command is printed in microseconds, as tab separated values.
+# With --storage, the workload is replaced by a storage benchmark: file size in bytes and mean load and save
+# latency in microseconds for every storage format, over STORAGE_SIZES entries, as tab separated values.
+set -e
+
+AWEEK=$(realpath "$1")
+TIME=false
+STORAGE=false
+[ "$2" = "--time" ] && TIME=true
+[ "$2" = "--storage" ] && STORAGE=true
+RUNS=${RUNS:-20}
+SIZES=${SIZES:-"100 10000"}
+STORAGE_RUNS=${STORAGE_RUNS:-3}
+STORAGE_SIZES=${STORAGE_SIZES:-"1000 100000 1000000"}
+STORAGE_FORMATS=${STORAGE_FORMATS:-"json json.gz cbor cbor.gz"}
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+export XDG_CONFIG_HOME="$WORKDIR"
+mkdir -p "$WORKDIR/aweek"
+
+# watchlist with a mix of airing, finished, upcoming, delayed and ignored anime, named in mixed scripts
+generate() {
+	awk -v n="$1" -v now="$(date +%s)" 'BEGIN {
+		srand(n);
+		split("Anime %d|薬屋のひとりごと 第%d期|진격의 거인 %d|Pokémon Ω %d|Tensei Shitara Slime Datta Ken Season %d", names, "|");
+		print "[";
+		for (i = 0; i < n; i++) {
+			episodes = 12 + int(rand() * 14);
+			if (i == 0) episodes = 1000; # long running show, takes repeated quick updates
+			start = now - int(rand() * 40 * 7 * 86400) + 14 * 86400;
+			delayed = (i % 7 == 0) ? "[ 3 ]" : "[ ]";
+			printf "{ \"name\": \"" names[i % 5 + 1] "\", \"episodes\": %d, \"episodes_downloaded\": %d, ", i, episodes, int(rand() * episodes);
+			printf "\"start_date\": %d, \"delayed_episodes\": %s, \"ignored\": %s }%s\n", start, delayed, (i % 11 == 0) ? "true" : "false", (i < n - 1) ? "," : "";
+		}
+		print "]";
+	}'
+}
+
+now_us() {
+	echo $(( $(date +%s%N) / 1000 ))
+}
+
+# mean_us <runs> <args...>: prints the mean latency of the command in microseconds
+mean_us() {
+	runs=$1
+	shift
+	start=$(now_us)
+	i=0
+	while [ $i -lt "$runs" ]; do
+		"$AWEEK" "$@" >/dev/null
+		i=$((i + 1))
+	done
+	end=$(now_us)
+	echo $(( (end - start) / runs ))
+}
+
+# run <label> <args...>: runs the command RUNS times on a fresh copy of the watchlist
+run() {
+	label=$1
+	shift
+	cp "$WORKDIR/base.json" "$WORKDIR/aweek/anime.json"
+	mean=$(mean_us "$RUNS" "$@")
+	$TIME && printf "%s\t%s\t%d\n" "$size" "$label" "$mean"
+	return 0
+}
+
+# every command loads the anime file first, so version measures loading alone,
+# and export measures loading and saving in the same format
+if $STORAGE; then
+	printf "entries\tformat\tbytes\tload_us\tsave_us\n"
+	for size in $STORAGE_SIZES; do
+		generate "$size" >"$WORKDIR/base.json"
+		for format in $STORAGE_FORMATS; do
+			cp "$WORKDIR/base.json" "$WORKDIR/aweek/anime.json"
+			"$AWEEK" export "$WORKDIR/base.$format" "$format"
+			cp "$WORKDIR/base.$format" "$WORKDIR/aweek/anime.json"
+			"$AWEEK" v >/dev/null # warm up the page cache
+			load=$(mean_us "$STORAGE_RUNS" v)
+			load_save=$(mean_us "$STORAGE_RUNS" export "$WORKDIR/saved.$format" "$format")
+			printf "%s\t%s\t%d\t%d\t%d\n" "$size" "$format" "$(wc -c <"$WORKDIR/base.$format")" "$load" $((load_save - load))
+		done
+	done
+	exit 0
+fi
+
+for size in $SIZES; do
+	generate "$size" >"$WORKDIR/base.json"
+	run "new-episodes"
+	run "n" n
+	run "l" l
+	run "template" --template '{count} new: {name} #{episode}'
+	run "u (quick)" u 1
+	run "u (set)" u 2 5
+	run "i" i 3
+	run "export cbor.gz" export "$WORKDIR/export.cbor.gz" cbor.gz
+	"$AWEEK" export "$WORKDIR/base.cbor.gz" cbor.gz
+	cp "$WORKDIR/base.cbor.gz" "$WORKDIR/base.json"
+	run "u (cbor.gz)" u 1
+	run "n (cbor.gz)" n
+done
@@ -2,86 +2,318 @@
 #define _GNU_SOURCE
 #include <json.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
 #include "../include/anime_functions.h"
+#include "../include/list_import.h"
+#include "../include/utf8.h"
+#include "../include/history.h"
+#include "../include/probes.h"
+
+#define WEEK_SECONDS (7 * 24 * 60 * 60)
+#define LIST_FIXED_COLUMNS 43 // every list column except the anime name, with separators
+#define LIST_DEFAULT_COLUMNS 73
+#define LIST_MIN_NAME_COLUMNS 10
+#define LIST_MAX_NAME_COLUMNS 60
+
+/**
+ * Helper function to get the number of already aired episodes for an anime
+ * @param anime anime json object
+ * @param now time to count aired episodes at
+ * @return the number of aired episodes, at most the anime's episode count, or -1 on error
+ */
+int get_aired_episodes_count(struct json_object * anime, time_t now) {
+	size_t j, episodes_all, episodes_available, n_episodes_delayed;
+	struct json_object * anime_episodes;
+	struct json_object * anime_start_date;
+	struct json_object * anime_delayed_episodes;
+	struct json_object * delayed_episode;
+	time_t start_unix;
+
+	if (!json_object_object_get_ex(anime, "episodes", &anime_episodes)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	if (!json_object_object_get_ex(anime, "start_date", &anime_start_date)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	start_unix = json_object_get_int64(anime_start_date);
+	if (now < start_unix) return 0; // the anime hasn't started airing yet
+
+	if (!json_object_object_get_ex(anime, "delayed_episodes", &anime_delayed_episodes)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	n_episodes_delayed = json_object_array_length(anime_delayed_episodes);
+
+	// count how many weeks have passed since start date, adding 1 because start date == first episode
+	episodes_available = ((now - start_unix) / WEEK_SECONDS) + 1;
+	for (j=0; j<n_episodes_delayed; j++) {
+		delayed_episode = json_object_array_get_idx(anime_delayed_episodes, j);
+		if (json_object_get_uint64(delayed_episode) <= episodes_available) episodes_available--;
+	}
+
+	episodes_all = json_object_get_uint64(anime_episodes);
+	if (episodes_available > episodes_all) episodes_available = episodes_all;
+
+	return (int) episodes_available;
+}
+
+/**
+ * Anime selected for listing, with its sort key computed up front
+ */
+struct list_row {
+	size_t at;
+	const char * name; // set only when sorting by name
+	int64_t key;
+};
+
+/**
+ * Helper function to order list rows, ties are broken by anime id so the order is stable
+ * @param a first row
+ * @param b second row
+ * @return negative, zero or positive, like strcmp
+ */
+int list_row_compare(const void * a, const void * b) {
+	const struct list_row * row_a = a;
+	const struct list_row * row_b = b;
+	int result;
+
+	if (row_a->name != NULL) {
+		result = strcasecmp(row_a->name, row_b->name);
+		if (result != 0) return result;
+	} else if (row_a->key != row_b->key) {
+		return row_a->key < row_b->key ? -1 : 1;
+	}
+	return row_a->at < row_b->at ? -1 : row_a->at > row_b->at;
+}
+
+/**
+ * Helper function to keep the k smallest rows seen so far in a max heap
+ * @param heap heap of rows, the largest row is at the top
+ * @param size current heap size, updated
+ * @param k maximum heap size
+ * @param row row to offer to the heap
+ */
+void list_heap_offer(struct list_row * heap, size_t * size, size_t k, const struct list_row * row) {
+	size_t at, child;
+	struct list_row temp;
+
+	if (*size < k) { // sift up
+		at = (*size)++;
+		heap[at] = *row;
+		while (at > 0 && list_row_compare(&heap[(at - 1) / 2], &heap[at]) < 0) {
+			temp = heap[at];
+			heap[at] = heap[(at - 1) / 2];
+			heap[(at - 1) / 2] = temp;
+			at = (at - 1) / 2;
+		}
+		return;
+	}
+	if (list_row_compare(row, &heap[0]) >= 0) return;
+
+	// replace the largest row and sift down
+	heap[0] = *row;
+	at = 0;
+	while ((child = 2 * at + 1) < *size) {
+		if (child + 1 < *size && list_row_compare(&heap[child], &heap[child + 1]) < 0) child++;
+		if (list_row_compare(&heap[at], &heap[child]) >= 0) break;
+		temp = heap[at];
+		heap[at] = heap[child];
+		heap[child] = temp;
+		at = child;
+	}
+}
+
+/**
+ * Helper function to check an anime against list filters and compute its sort key
+ * @param anime anime json object
+ * @param options list options
+ * @param now current time
+ * @param row where to store the sort key
+ * @return 1 if the anime should be listed, 0 if not, or -1 on error
+ */
+int list_select(struct json_object * anime, const struct list_options * options, time_t now, struct list_row * row) {
+	int aired = 0;
+	int64_t episodes, downloaded, start_unix;
+	struct json_object * anime_name;
+	struct json_object * anime_episodes;
+	struct json_object * anime_episodes_downloaded;
+	struct json_object * anime_start_date;
+	struct json_object * anime_ignored;
+
+	if (!json_object_object_get_ex(anime, "name", &anime_name)
+		|| !json_object_object_get_ex(anime, "episodes", &anime_episodes)
+		|| !json_object_object_get_ex(anime, "episodes_downloaded", &anime_episodes_downloaded)
+		|| !json_object_object_get_ex(anime, "start_date", &anime_start_date)
+		|| !json_object_object_get_ex(anime, "ignored", &anime_ignored)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	episodes = json_object_get_int64(anime_episodes);
+	downloaded = json_object_get_int64(anime_episodes_downloaded);
+	start_unix = json_object_get_int64(anime_start_date);
+
+	if ((options->filter & (FILTER_AIRING | FILTER_FINISHED | FILTER_HAS_NEW)) || options->sort == SORT_NEXT_AIRING) {
+		aired = get_aired_episodes_count(anime, now);
+		if (aired < 0) return -1;
+	}
+
+	if ((options->filter & FILTER_AIRING) && (now < start_unix || aired >= episodes)) return 0;
+	if ((options->filter & FILTER_FINISHED) && (now < start_unix || aired < episodes)) return 0;
+	if ((options->filter & FILTER_IGNORED) && !json_object_get_boolean(anime_ignored)) return 0;
+	if ((options->filter & FILTER_HAS_NEW) && (json_object_get_boolean(anime_ignored) || aired <= downloaded)) return 0;
+
+	row->name = NULL;
+	switch (options->sort) {
+		case SORT_NAME:
+			row->name = json_object_get_string(anime_name);
+			break;
+		case SORT_NEXT_AIRING:
+			if (now < start_unix) {
+				row->key = start_unix;
+			} else if (aired >= episodes) {
+				row->key = INT64_MAX; // finished airing, listed last
+			} else {
+				row->key = start_unix + ((now - start_unix) / WEEK_SECONDS + 1) * WEEK_SECONDS;
+			}
+			break;
+		case SORT_REMAINING:
+			row->key = episodes - downloaded;
+			break;
+		case SORT_START:
+			row->key = start_unix;
+			break;
+		default:
+			row->key = 0; // file order, ties are broken by anime id
+			break;
+	}
+	return 1;
+}
 
 /**
- * List all saved anime
+ * Helper function to get the terminal width, falling back to COLUMNS and then to the classic table width
+ * @return number of terminal columns
+ */
+size_t get_terminal_columns() {
+	struct winsize size;
+	const char * columns;
+
+	if (isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) return size.ws_col;
+	columns = getenv("COLUMNS");
+	if (columns != NULL && strtoul(columns, NULL, 10) > 0) return strtoul(columns, NULL, 10);
+	return LIST_DEFAULT_COLUMNS;
+}
+
+/**
+ * List saved anime
+ * Only anime on the requested page are formatted; with a limit, the top rows are selected instead of sorting all
  * @param anime_array json_object, must be of type json_type_array
+ * @param options sorting, filtering and pagination options
  * @return -1 on error, otherwise 0
  */
-int list_all(struct json_object * anime_array) {
-	size_t i, n_anime;
+int list_all(struct json_object * anime_array, const struct list_options * options) {
+	size_t i, n_anime, n_rows, k, name_columns;
+	int selected;
 	struct json_object * anime;
 	struct json_object * anime_name;
 	struct json_object * anime_episodes;
 	struct json_object * anime_episodes_downloaded;
 	struct json_object * anime_start_date;
+	struct list_row * rows;
+	struct list_row row;
 	time_t start_unix;
+	time_t now = time(NULL);
 	struct tm * start_datetime;
 	char start_string[16];
 
-	printf("%3c | %-30.30s | %-8.8s | %-22.22s\n", '#', "Anime name", "Episodes", "Broadcast (Local Time)");
-	for (i=0; i<73; i++) putchar('-');
-	putchar('\n');
-
 	n_anime = json_object_array_length(anime_array);
-
-	for (i=0; i<n_anime; i++) {
-		anime = json_object_array_get_idx(anime_array, i);
-		if (!json_object_object_get_ex(anime, "name", &anime_name)) {
-			fprintf(stderr, "Malformed json\n");
-			return -1;
-		}
-		if (!json_object_object_get_ex(anime, "episodes", &anime_episodes)) {
-			fprintf(stderr, "Malformed json\n");
-			return -1;
-		}
-		if (!json_object_object_get_ex(anime, "episodes_downloaded", &anime_episodes_downloaded)) {
-			fprintf(stderr, "Malformed json\n");
+	PROBE4(list__start, n_anime, options->sort, options->filter, options->limit);
+	// rows past offset + limit are never printed, so they are not kept either
+	k = n_anime;
+	if (options->offset >= n_anime) {
+		k = 0; // the page is past the end, nothing is selected
+	} else if (options->limit != 0 && options->limit < n_anime - options->offset) {
+		k = options->offset + options->limit;
+	}
+	rows = malloc((k + 1) * sizeof(struct list_row));
+	if (rows == NULL) return -1;
+
+	n_rows = 0;
+	for (i=0; k != 0 && i<n_anime; i++) {
+		row.at = i;
+		selected = list_select(json_object_array_get_idx(anime_array, i), options, now, &row);
+		if (selected < 0) {
+			free(rows);
 			return -1;
 		}
-		if (!json_object_object_get_ex(anime, "start_date", &anime_start_date)) {
-			fprintf(stderr, "Malformed json\n");
-			return -1;
+		if (!selected) continue;
+		if (k == n_anime) {
+			rows[n_rows++] = row;
+		} else {
+			list_heap_offer(rows, &n_rows, k, &row);
 		}
+	}
+	if (options->sort != SORT_NONE || k != n_anime) qsort(rows, n_rows, sizeof(struct list_row), list_row_compare);
+
+	// the name column takes whatever the other columns leave of the terminal width
+	name_columns = get_terminal_columns();
+	name_columns = name_columns > LIST_FIXED_COLUMNS ? name_columns - LIST_FIXED_COLUMNS : 0;
+	if (name_columns < LIST_MIN_NAME_COLUMNS) name_columns = LIST_MIN_NAME_COLUMNS;
+	if (name_columns > LIST_MAX_NAME_COLUMNS) name_columns = LIST_MAX_NAME_COLUMNS;
+
+	printf("%3c | %-*.*s | %-8.8s | %-22.22s\n", '#', (int) name_columns, (int) name_columns, "Anime name", "Episodes", "Broadcast (Local Time)");
+	for (i=0; i<name_columns + LIST_FIXED_COLUMNS; i++) putchar('-');
+	putchar('\n');
+
+	for (i=options->offset; i<n_rows; i++) {
+		anime = json_object_array_get_idx(anime_array, rows[i].at);
+		json_object_object_get_ex(anime, "name", &anime_name);
+		json_object_object_get_ex(anime, "episodes", &anime_episodes);
+		json_object_object_get_ex(anime, "episodes_downloaded", &anime_episodes_downloaded);
+		json_object_object_get_ex(anime, "start_date", &anime_start_date);
 		start_unix = json_object_get_int64(anime_start_date);
 		start_datetime = localtime(&start_unix);
 		if (strftime(start_string, sizeof(start_string), "%A\t%H:%M", start_datetime) == 0) {
 			fprintf(stderr, "Failed to fit formatted start date in a char array\n");
+			free(rows);
 			return -1;
 		}
-		printf("%3zu | %-30.30s | %3d/%-4d | %-15.15s\n",
-			   i+1,
-			   json_object_get_string(anime_name),
+		printf("%3zu | ", rows[i].at+1);
+		utf8_print_column(stdout, json_object_get_string(anime_name), json_object_get_string_len(anime_name), name_columns);
+		printf(" | %3d/%-4d | %-15.15s\n",
 			   json_object_get_int(anime_episodes_downloaded),
 			   json_object_get_int(anime_episodes),
 			   start_string);
 	}
 
-	for (i=0; i<73; i++) putchar('-');
+	for (i=0; i<name_columns + LIST_FIXED_COLUMNS; i++) putchar('-');
 	putchar('\n');
+	free(rows);
+	PROBE1(list__done, n_rows);
 	return 0;
 }
 
 /**
- * Helper function to get the number of available episodes for an anime
+ * Helper function to count new episodes for an anime, see get_new_episodes_count()
  * @param anime_array json_object, must be of type json_type_array
  * @param anime_at index of the anime to get the count for
  * @return the number of new episodes for the anime or -1 on error
  */
-int get_new_episodes_count(struct json_object * anime_array, size_t anime_at) {
-	size_t j, episodes_all, episodes_downloaded, episodes_available, n_episodes_delayed;
+int count_new_episodes(struct json_object * anime_array, size_t anime_at) {
+	size_t episodes_all, episodes_downloaded;
+	int episodes_available;
 	struct json_object * anime;
 	struct json_object * anime_episodes;
 	struct json_object * anime_episodes_downloaded;
-	struct json_object * anime_start_date;
-	struct json_object * anime_delayed_episodes;
-	struct json_object * delayed_episode;
 	struct json_object * anime_ignored;
-	time_t start_unix;
-	time_t now = time(NULL);
 
 	anime = json_object_array_get_idx(anime_array, anime_at);
 	if (!json_object_object_get_ex(anime, "ignored", &anime_ignored)) {
@@ -104,31 +336,27 @@ int get_new_episodes_count(struct json_object * anime_array, size_t anime_at) {
 	// skip fully downloaded
 	if (episodes_all <= episodes_downloaded) return 0;
 
-	if (!json_object_object_get_ex(anime, "start_date", &anime_start_date)) {
-		fprintf(stderr, "Malformed json\n");
-		return -1;
-	}
-	start_unix = json_object_get_int64(anime_start_date);
-	if (now < start_unix) return 0; // the anime hasn't started airing yet
+	episodes_available = get_aired_episodes_count(anime, time(NULL));
+	if (episodes_available < 0) return -1;
 
-	if (!json_object_object_get_ex(anime, "delayed_episodes", &anime_delayed_episodes)) {
-		fprintf(stderr, "Malformed json\n");
-		return -1;
-	}
-	n_episodes_delayed = json_object_array_length(anime_delayed_episodes);
+	if ((size_t) episodes_available <= episodes_downloaded) return 0;
 
-	// calculating already aired episodes
-	now -= start_unix;
-	// count how many weeks have passed since start date, adding 1 because start date == first episode
-	episodes_available = (now / (7 * 24 * 60 * 60)) + 1;
-	for (j=0; j<n_episodes_delayed; j++) {
-		delayed_episode = json_object_array_get_idx(anime_delayed_episodes, anime_at);
-		if (json_object_get_uint64(delayed_episode) <= episodes_available) episodes_available--;
-	}
+	return (int) (episodes_available - episodes_downloaded);
+}
 
-	if (episodes_available <= episodes_downloaded) return 0;
+/**
+ * Helper function to get the number of available episodes for an anime
+ * @param anime_array json_object, must be of type json_type_array
+ * @param anime_at index of the anime to get the count for
+ * @return the number of new episodes for the anime or -1 on error
+ */
+int get_new_episodes_count(struct json_object * anime_array, size_t anime_at) {
+	int new_episodes;
 
-	return (int) (episodes_available - episodes_downloaded);
+	PROBE1(new_episodes__start, anime_at);
+	new_episodes = count_new_episodes(anime_array, anime_at);
+	PROBE2(new_episodes__done, anime_at, new_episodes);
+	return new_episodes;
 }
 
 /**
@@ -196,6 +424,44 @@ int print_new_episodes_count(struct json_object * anime_array) {
 	return 0;
 }
 
+/**
+ * Generate a random unique id for an anime, stable across machines it is synchronized to
+ * @param uid where to store the id, must fit ANIME_UID_LENGTH characters and a '\0'
+ * @return 0 on success, otherwise -1 on error
+ */
+int make_anime_uid(char * uid) {
+	static const char digits[] = "0123456789abcdef";
+	unsigned char bytes[ANIME_UID_LENGTH / 2];
+	size_t i;
+
+	if (getrandom(bytes, sizeof(bytes), 0) != sizeof(bytes)) {
+		fprintf(stderr, "Failed to generate anime id\n");
+		return -1;
+	}
+	for (i=0; i<sizeof(bytes); i++) {
+		uid[2 * i] = digits[bytes[i] >> 4];
+		uid[2 * i + 1] = digits[bytes[i] & 0x0F];
+	}
+	uid[ANIME_UID_LENGTH] = '\0';
+	return 0;
+}
+
+/**
+ * Record that an anime field was just changed, used to resolve conflicts when synchronizing
+ * @param anime anime that was changed
+ * @param field name of the changed field
+ * @return 0 on success, otherwise -1 on error
+ */
+int touch_anime_field(struct json_object * anime, const char * field) {
+	struct json_object * versions_obj;
+
+	if (!json_object_object_get_ex(anime, "versions", &versions_obj)) {
+		versions_obj = json_object_new_object();
+		if (json_object_object_add(anime, "versions", versions_obj) != 0) return -1;
+	}
+	return json_object_object_add(versions_obj, field, json_object_new_int64(time(NULL)));
+}
+
 /**
  * Helper function to create an anime json object from provided values
  * @param name anime name
@@ -204,8 +470,12 @@ int print_new_episodes_count(struct json_object * anime_array) {
  * @return a pointer to anime json object or NULL on error
  */
 struct json_object * make_anime_json_object(char * name, size_t episodes, time_t start_date) {
-	struct json_object * anime_obj = json_object_new_object();
+	char uid[ANIME_UID_LENGTH + 1];
+	struct json_object * anime_obj;
 
+	if (make_anime_uid(uid) != 0) return NULL;
+	anime_obj = json_object_new_object();
+	if (json_object_object_add(anime_obj, "uid", json_object_new_string(uid)) != 0) return NULL;
 	if (json_object_object_add(anime_obj, "name", json_object_new_string(name)) != 0) return NULL;
 	if (json_object_object_add(anime_obj, "episodes", json_object_new_uint64(episodes)) != 0) return NULL;
 	if (json_object_object_add(anime_obj, "episodes_downloaded", json_object_new_uint64(0)) != 0) return NULL;
@@ -278,18 +548,23 @@ struct json_object * make_anime_manual() {
 }
 
 /**
- * Create and add a new anime json object to the provided json array
- * @param anime_array json array to add the new anime json object to
- * @param method the method to use when creating a new anime json object
- * @return `0` if the anime was created and added successfully, otherwise `-1` on error
+ * Create and add new anime json objects to the provided json array
+ * @param anime_array json array to add the new anime json objects to
+ * @param method the method to use when creating new anime json objects
+ * @param source export file to import anime from, unused for MANUAL
+ * @return `0` if the anime were created and added successfully, otherwise `-1` on error
  */
-int add_anime(struct json_object * anime_array, enum ADD_ANIME_METHOD method) {
+int add_anime(struct json_object * anime_array, enum ADD_ANIME_METHOD method, const char * source) {
 	struct json_object * anime; // do not try to json_object_put() this
 
 	switch (method) {
 		case MANUAL:
 			anime = make_anime_manual();
 			break;
+		case MAL_EXPORT:
+			return add_anime_from_mal_export(anime_array, source);
+		case ANILIST_EXPORT:
+			return add_anime_from_anilist_export(anime_array, source);
 		default:
 			return -1;
 	}
@@ -333,6 +608,7 @@ int edit_anime(struct json_object * anime) {
 	char delayed_episodes_str[5]; // string to store input for scanning later
 	struct json_object * delayed_episode_obj; // an array of delayed episodes
 	struct json_object * delayed_episodes_obj;
+	struct json_object * new_delayed_episodes_obj;
 
 	char ignored_str[6];
 	struct json_object * ignored_obj;
@@ -374,6 +650,7 @@ int edit_anime(struct json_object * anime) {
 				fprintf(stderr, "Failed to set new anime name\n");
 				return -1;
 			}
+			if (touch_anime_field(anime, "name") != 0) return -1;
 			break;
 		case 2: // episodes
 			if (!json_object_object_get_ex(anime, "episodes", &episodes_obj)) {
@@ -397,6 +674,7 @@ int edit_anime(struct json_object * anime) {
 				fprintf(stderr, "Failed to set new anime episodes count\n");
 				return -1;
 			}
+			if (touch_anime_field(anime, "episodes") != 0) return -1;
 			break;
 		case 3: // episodes downloaded
 			if (!json_object_object_get_ex(anime, "episodes_downloaded", &episodes_obj)) {
@@ -458,6 +736,7 @@ int edit_anime(struct json_object * anime) {
 				fprintf(stderr, "Failed to set new anime broadcast start date\n");
 				return -1;
 			}
+			if (touch_anime_field(anime, "start_date") != 0) return -1;
 			break;
 		case 5: // delayed episodes
 			if (!json_object_object_get_ex(anime, "delayed_episodes", &delayed_episodes_obj)) {
@@ -488,8 +767,9 @@ int edit_anime(struct json_object * anime) {
 			}
 
 			delayed_episodes_str[sizeof(delayed_episodes_str)-1] = '\0';
-			// clear current delayed episodes array TODO this makes saving after edit_anime() returns an error unsafe
-			json_object_array_del_idx(delayed_episodes_obj, 0, delayed_episodes_length);
+			// new delayed episodes replace the current ones only once all of them are parsed
+			new_delayed_episodes_obj = json_object_new_array();
+			if (new_delayed_episodes_obj == NULL) return -1;
 			printf("Enter new anime delayed episodes: ");
 			while (getchar() != '\n'); // clear stdin
 			while (scanning) {
@@ -515,13 +795,15 @@ int edit_anime(struct json_object * anime) {
 					delayed_episode_temp = strtoul(delayed_episodes_str, NULL, 0);
 					if (delayed_episode_temp == 0) { // episode can't be zero, strtoul returns zero on error
 						fprintf(stderr, "Failed to convert '%s' to a number\n", delayed_episodes_str);
+						json_object_put(new_delayed_episodes_obj);
 						return -1;
 					}
-					json_object_array_add(delayed_episodes_obj, json_object_new_uint64(delayed_episode_temp));
+					json_object_array_add(new_delayed_episodes_obj, json_object_new_uint64(delayed_episode_temp));
 				}
 			}
 
-			json_object_array_shrink(delayed_episodes_obj, 0);
+			json_object_object_add(anime, "delayed_episodes", new_delayed_episodes_obj);
+			if (touch_anime_field(anime, "delayed_episodes") != 0) return -1;
 			break;
 		case 6: // ignored
 			if (!json_object_object_get_ex(anime, "ignored", &ignored_obj)) {
@@ -541,17 +823,16 @@ int edit_anime(struct json_object * anime) {
 					fprintf(stderr, "Failed to set new anime ignored flag\n");
 					return -1;
 				}
-				break;
 			} else if (strcmp(ignored_str, "False") == 0) {
 				if (!json_object_set_boolean(ignored_obj, 0)) {
 					fprintf(stderr, "Failed to set new anime ignored flag\n");
 					return -1;
 				}
-				break;
 			} else {
 				fprintf(stderr, "Failed to parse new anime ignored flag\n");
 				return -1;
 			}
+			if (touch_anime_field(anime, "ignored") != 0) return -1;
 			break;
 		default:
 			fprintf(stderr, "Bad choice number\n");
@@ -590,6 +871,7 @@ int delete_anime(struct json_object * anime_array, size_t delete_at) {
  * @return 0 on success, otherwise -1 on error
  */
 int update_anime(struct json_object * anime, size_t downloaded_episodes) {
+	size_t previous_episodes;
 	struct json_object * episodes_obj;
 	struct json_object * downloaded_episodes_obj;
 
@@ -607,10 +889,13 @@ int update_anime(struct json_object * anime, size_t downloaded_episodes) {
 		return -1;
 	}
 
+	previous_episodes = json_object_get_uint64(downloaded_episodes_obj);
 	if (!json_object_set_uint64(downloaded_episodes_obj, downloaded_episodes)) {
 		fprintf(stderr, "Failed to set new anime downloaded episodes count\n");
 		return -1;
 	}
+	if (touch_anime_field(anime, "episodes_downloaded") != 0) return -1;
+	if (history_record(anime, previous_episodes, downloaded_episodes, time(NULL)) != 0) return -1;
 
 	return 0;
 }
@@ -648,6 +933,7 @@ int toggle_anime_ignored(struct json_object * anime) {
 		fprintf(stderr, "Failed to set new anime ignored flag\n");
 		return -1;
 	}
+	if (touch_anime_field(anime, "ignored") != 0) return -1;
 
 	return 0;
 }
@@ -0,0 +1,688 @@
+#include <json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/anime_functions.h"
+#include "../include/history.h"
+
+#define WEEK_SECONDS (7 * 24 * 60 * 60)
+#define DAY_SECONDS (24 * 60 * 60)
+#define HISTORY_WEEK_ORIGIN (4 * DAY_SECONDS) // 1970-01-05, the first Monday after the epoch
+#define HISTORY_MAGIC "aweekhs2"
+#define HISTORY_WEEKS_MAGIC "aweekwk2"
+#define HISTORY_ANIME_MAGIC "aweekan2"
+#define HISTORY_ANIME_CAPACITY 64 // initial number of slots of the per anime rollups table
+#define HISTORY_STATS_WEEKS 8 // weeks shown by print_stats()
+#define HISTORY_READ_EVENTS 512 // events read at once when summing a date range
+
+/**
+ * Header at the start of every history file
+ */
+struct history_header {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t used; // slots in use, only in the per anime rollups file
+	uint64_t applied; // events of the history file counted so far, only in the rollup files
+};
+
+/**
+ * Files holding rollups of the history file
+ */
+enum HISTORY_ROLLUP {
+	HISTORY_WEEKS,
+	HISTORY_ANIME
+};
+
+/**
+ * Download events recorded since the anime array was loaded, appended to the history file once it is saved
+ */
+static struct {
+	struct history_event * events;
+	size_t length, size;
+} history_pending;
+
+/**
+ * Helper function to get the week a time falls in, weeks start on Monday 00:00 UTC
+ * @param time unix time
+ * @return week index since the epoch
+ */
+int64_t history_week_of(int64_t time) {
+	return time < HISTORY_WEEK_ORIGIN ? 0 : (time - HISTORY_WEEK_ORIGIN) / WEEK_SECONDS;
+}
+
+/**
+ * Helper function to get the key the downloads of an anime are kept under
+ * Anime are keyed by their id, anime saved before ids existed by a hash of their name until they get one
+ * @param anime anime json object
+ * @param by_name whether to get the name key even if the anime has an id
+ * @return key, never 0
+ */
+uint64_t history_anime_key(struct json_object * anime, int by_name) {
+	uint64_t key = 14695981039346656037ULL;
+	const char * name;
+	struct json_object * value;
+
+	if (!by_name && json_object_object_get_ex(anime, "uid", &value)) {
+		key = strtoull(json_object_get_string(value), NULL, 16);
+	} else if (json_object_object_get_ex(anime, "name", &value)) {
+		for (name = json_object_get_string(value); *name != '\0'; name++) { // FNV-1a
+			key ^= (unsigned char) *name;
+			key *= 1099511628211ULL;
+		}
+	}
+	return key == 0 ? 1 : key; // 0 marks free slots
+}
+
+/**
+ * Record that episodes of an anime were downloaded
+ * The event is kept pending until history_flush()
+ * @param anime anime whose downloaded episodes count changed
+ * @param from downloaded episodes count before the change
+ * @param to downloaded episodes count after the change, nothing is recorded unless it is bigger than from
+ * @param now time of the change
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_record(struct json_object * anime, size_t from, size_t to, time_t now) {
+	size_t episode, j, n_delayed;
+	int64_t start, air, lag = 0;
+	uint32_t lag_episodes = 0;
+	struct json_object * start_obj;
+	struct json_object * delayed_obj;
+	struct history_event * event;
+
+	if (to <= from) return 0;
+	if (to > UINT32_MAX) {
+		fprintf(stderr, "Downloaded episodes count is too big to record\n");
+		return -1;
+	}
+	if (!json_object_object_get_ex(anime, "start_date", &start_obj)
+		|| !json_object_object_get_ex(anime, "delayed_episodes", &delayed_obj)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	start = json_object_get_int64(start_obj);
+	n_delayed = json_object_array_length(delayed_obj);
+
+	// an episode airs a week after the previous one, every delayed episode up to it pushes it back a week
+	for (episode=from+1; episode<=to; episode++) {
+		air = start + (int64_t) (episode - 1) * WEEK_SECONDS;
+		for (j=0; j<n_delayed; j++) {
+			if (json_object_get_uint64(json_object_array_get_idx(delayed_obj, j)) <= episode) air += WEEK_SECONDS;
+		}
+		if (air > now) continue; // downloaded before it aired, has no lag
+		lag += now - air;
+		lag_episodes++;
+	}
+
+	if (history_pending.length == history_pending.size) {
+		history_pending.size = history_pending.size == 0 ? 16 : history_pending.size * 2;
+		event = realloc(history_pending.events, history_pending.size * sizeof(struct history_event));
+		if (event == NULL) return -1;
+		history_pending.events = event;
+	}
+	event = &history_pending.events[history_pending.length++];
+	event->time = now;
+	event->anime = history_anime_key(anime, 0);
+	event->from = (uint32_t) from;
+	event->to = (uint32_t) to;
+	event->lag_episodes = lag_episodes;
+	event->reserved = 0;
+	event->lag = lag;
+	return 0;
+}
+
+/**
+ * Drop pending download events, e.g. because the anime array was not saved
+ */
+void history_discard() {
+	free(history_pending.events);
+	history_pending.events = NULL;
+	history_pending.length = 0;
+	history_pending.size = 0;
+}
+
+/**
+ * Helper function to open a history file and check its header, an empty file gets one written when creating files
+ * @param dir_fd folder to resolve the file against
+ * @param filepath history file
+ * @param flags open() flags
+ * @param magic expected magic bytes
+ * @param record_size expected record size
+ * @param size where to store the file size
+ * @return file descriptor, or -1 on error, errno is ENOENT if the file does not exist or is empty
+ */
+int history_open(int dir_fd, const char * filepath, int flags, const char * magic, uint32_t record_size, off_t * size) {
+	struct history_header header;
+	struct stat file_stat;
+	int fd = openat(dir_fd, filepath, flags | O_CLOEXEC, 0644);
+	if (fd == -1) return -1;
+
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		return -1;
+	}
+	*size = file_stat.st_size;
+	if (*size == 0 && (flags & O_CREAT)) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, magic, sizeof(header.magic));
+		header.record_size = record_size;
+		if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+			close(fd);
+			return -1;
+		}
+		*size = sizeof(header);
+		return fd;
+	}
+	if (*size == 0) { // emptied after a failed update, the next flush writes a new header
+		close(fd);
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+		|| memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.record_size != record_size) {
+		fprintf(stderr, "Malformed %s file\n", filepath);
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Helper function to append pending events to the history file in a single write
+ * @param dir_fd app subfolder
+ * @param counted where to store the number of events in the history file before the pending events
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_append_events(int dir_fd, uint64_t * counted) {
+	size_t i;
+	off_t size;
+	ssize_t length = (ssize_t) (history_pending.length * sizeof(struct history_event));
+	struct history_event last;
+	int fd = history_open(dir_fd, HISTORY_FILENAME, O_RDWR | O_CREAT | O_APPEND, HISTORY_MAGIC, sizeof(struct history_event), &size);
+	if (fd == -1) return -1;
+
+	if ((size - (off_t) sizeof(struct history_header)) % sizeof(struct history_event) != 0) {
+		fprintf(stderr, "Malformed " HISTORY_FILENAME " file\n");
+		close(fd);
+		return -1;
+	}
+	*counted = (size - sizeof(struct history_header)) / sizeof(struct history_event);
+	// events stay ordered by time even if the clock goes back, so date ranges can be binary searched
+	last.time = 0;
+	if (size > (off_t) sizeof(struct history_header)
+		&& pread(fd, &last, sizeof(last), size - sizeof(last)) != sizeof(last)) {
+		close(fd);
+		return -1;
+	}
+	for (i=0; i<history_pending.length; i++) {
+		if (history_pending.events[i].time < last.time) history_pending.events[i].time = last.time;
+		last.time = history_pending.events[i].time;
+	}
+
+	if (write(fd, history_pending.events, length) != length) {
+		if (ftruncate(fd, size) != 0) { // a partly written event would leave the file malformed
+			fprintf(stderr, "Malformed " HISTORY_FILENAME " file\n");
+		}
+		close(fd);
+		return -1;
+	}
+	return close(fd);
+}
+
+/**
+ * Helper function to add events to the weekly rollups and totals
+ * @param fd weekly rollups file
+ * @param header header of the file, nothing is counted yet if its applied count is 0
+ * @param events events ordered by time
+ * @param length number of events, at least 1
+ * @param backlog new episodes left after the events, NULL to keep the one stored
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_add_weeks(int fd, const struct history_header * header, const struct history_event * events, size_t length, const uint32_t * backlog) {
+	size_t i;
+	off_t offset = 0;
+	int64_t week_at = -1, week;
+	struct history_totals totals;
+	struct history_week rollup;
+
+	if (header->applied == 0) {
+		memset(&totals, 0, sizeof(totals));
+		totals.first_week = history_week_of(events[0].time);
+	} else if (pread(fd, &totals, sizeof(totals), sizeof(struct history_header)) != sizeof(totals)) {
+		return -1;
+	}
+
+	// events are ordered by time, so every week is read and written once
+	for (i=0; i<length; i++) {
+		week = history_week_of(events[i].time) - totals.first_week;
+		if (week < 0) week = 0;
+		if (week != week_at) {
+			if (week_at >= 0 && pwrite(fd, &rollup, sizeof(rollup), offset) != sizeof(rollup)) return -1;
+			week_at = week;
+			offset = sizeof(struct history_header) + sizeof(struct history_totals) + week * sizeof(struct history_week);
+			memset(&rollup, 0, sizeof(rollup)); // weeks past the end of the file have no downloads yet
+			if (pread(fd, &rollup, sizeof(rollup), offset) < 0) return -1;
+		}
+		rollup.episodes += events[i].to - events[i].from;
+		rollup.lag_episodes += events[i].lag_episodes;
+		rollup.lag += events[i].lag;
+		rollup.events++;
+		totals.episodes += events[i].to - events[i].from;
+		totals.lag_episodes += events[i].lag_episodes;
+		totals.lag += events[i].lag;
+		totals.events++;
+	}
+	if (backlog != NULL) rollup.backlog = *backlog;
+
+	if (pwrite(fd, &rollup, sizeof(rollup), offset) != sizeof(rollup)
+		|| pwrite(fd, &totals, sizeof(totals), sizeof(struct history_header)) != sizeof(totals)) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to find the slot of an anime in the per anime rollups table, an open addressing hash table
+ * @param fd per anime rollups file
+ * @param capacity number of slots, a power of two bigger than the number of slots in use
+ * @param key anime key, see history_anime_key()
+ * @param at where to store the index of the slot holding the anime, or of the free slot to store it in
+ * @param rollup where to store the slot
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_anime_find(int fd, size_t capacity, uint64_t key, size_t * at, struct history_anime * rollup) {
+	*at = (size_t) key & (capacity - 1);
+	for (;;) {
+		if (pread(fd, rollup, sizeof(*rollup), sizeof(struct history_header) + *at * sizeof(*rollup)) != sizeof(*rollup)) return -1;
+		if (rollup->anime == 0 || rollup->anime == key) return 0;
+		*at = (*at + 1) & (capacity - 1);
+	}
+}
+
+/**
+ * Helper function to double the number of slots of the per anime rollups table, rehashing it
+ * @param fd per anime rollups file
+ * @param capacity current number of slots, 0 for a new file, updated
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_anime_grow(int fd, size_t * capacity) {
+	size_t i, at, new_capacity = *capacity == 0 ? HISTORY_ANIME_CAPACITY : *capacity * 2;
+	ssize_t length = (ssize_t) (*capacity * sizeof(struct history_anime));
+	ssize_t new_length = (ssize_t) (new_capacity * sizeof(struct history_anime));
+	struct history_anime * slots = malloc(length == 0 ? 1 : length);
+	struct history_anime * new_slots = calloc(new_capacity, sizeof(struct history_anime));
+
+	if (slots == NULL || new_slots == NULL || pread(fd, slots, length, sizeof(struct history_header)) != length) {
+		free(slots);
+		free(new_slots);
+		return -1;
+	}
+	for (i=0; i<*capacity; i++) {
+		if (slots[i].anime == 0) continue;
+		for (at = (size_t) slots[i].anime & (new_capacity - 1); new_slots[at].anime != 0; at = (at + 1) & (new_capacity - 1));
+		new_slots[at] = slots[i];
+	}
+
+	if (pwrite(fd, new_slots, new_length, sizeof(struct history_header)) != new_length) {
+		free(slots);
+		free(new_slots);
+		return -1;
+	}
+	free(slots);
+	free(new_slots);
+	*capacity = new_capacity;
+	return 0;
+}
+
+/**
+ * Helper function to add events to the per anime rollups
+ * @param fd per anime rollups file
+ * @param header header of the file, its used slots count is updated
+ * @param events events ordered by time
+ * @param length number of events
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_add_anime(int fd, struct history_header * header, const struct history_event * events, size_t length) {
+	size_t i, at, capacity;
+	struct history_anime rollup;
+	struct stat file_stat;
+
+	if (fstat(fd, &file_stat) != 0) return -1;
+	capacity = (file_stat.st_size - sizeof(struct history_header)) / sizeof(struct history_anime);
+	if (capacity == 0 && history_anime_grow(fd, &capacity) != 0) return -1;
+
+	for (i=0; i<length; i++) {
+		if (history_anime_find(fd, capacity, events[i].anime, &at, &rollup) != 0) return -1;
+		if (rollup.anime == 0) { // keep the table at most half full
+			if ((header->used + 1) * 2 > capacity
+				&& (history_anime_grow(fd, &capacity) != 0 || history_anime_find(fd, capacity, events[i].anime, &at, &rollup) != 0)) {
+				return -1;
+			}
+			rollup.anime = events[i].anime;
+			header->used++;
+		}
+		rollup.episodes += events[i].to - events[i].from;
+		rollup.lag_episodes += events[i].lag_episodes;
+		rollup.lag += events[i].lag;
+		rollup.last = events[i].time;
+		if (pwrite(fd, &rollup, sizeof(rollup), sizeof(struct history_header) + at * sizeof(rollup)) != sizeof(rollup)) return -1;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to empty a rollup file, so every event of the history file is counted again
+ * If the header cannot be written the file is left empty, the next flush writes a new one
+ * @param fd rollup file
+ * @param header header of the file, its counts are reset
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_reset_rollup(int fd, struct history_header * header) {
+	header->used = 0;
+	header->applied = 0;
+	if (pwrite(fd, header, sizeof(*header), 0) == sizeof(*header) && ftruncate(fd, sizeof(*header)) == 0) return 0;
+	return ftruncate(fd, 0);
+}
+
+/**
+ * Helper function to bring a rollup file up to date with the history file
+ * Usually only the pending events are not counted yet, events missed because an earlier update failed
+ * or the rollup file was deleted are read back from the history file
+ * A rollup file left partly updated is emptied, so the next flush counts every event again
+ * @param dir_fd app subfolder
+ * @param rollup rollup file to update
+ * @param counted number of events in the history file before the pending events
+ * @param backlog new episodes left after the pending events
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_update_rollup(int dir_fd, enum HISTORY_ROLLUP rollup, uint64_t counted, uint32_t backlog) {
+	size_t length;
+	off_t size;
+	int result = 0, history_fd = -1;
+	struct history_header header;
+	struct history_event missed[HISTORY_READ_EVENTS];
+	const struct history_event * events;
+	int fd = rollup == HISTORY_WEEKS
+		? history_open(dir_fd, HISTORY_WEEKS_FILENAME, O_RDWR | O_CREAT, HISTORY_WEEKS_MAGIC, sizeof(struct history_week), &size)
+		: history_open(dir_fd, HISTORY_ANIME_FILENAME, O_RDWR | O_CREAT, HISTORY_ANIME_MAGIC, sizeof(struct history_anime), &size);
+	if (fd == -1) return -1;
+
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		close(fd);
+		return -1;
+	}
+	if (header.applied > counted) result = history_reset_rollup(fd, &header); // counts events the history file does not have, it was replaced
+
+	while (result == 0 && header.applied < counted + history_pending.length) {
+		if (header.applied < counted) {
+			length = counted - header.applied < HISTORY_READ_EVENTS ? counted - header.applied : HISTORY_READ_EVENTS;
+			if (history_fd == -1) {
+				history_fd = history_open(dir_fd, HISTORY_FILENAME, O_RDONLY, HISTORY_MAGIC, sizeof(struct history_event), &size);
+			}
+			if (history_fd == -1 || pread(history_fd, missed, length * sizeof(struct history_event),
+										  sizeof(struct history_header) + header.applied * sizeof(struct history_event))
+									!= (ssize_t) (length * sizeof(struct history_event))) {
+				result = -1;
+				break;
+			}
+			events = missed;
+		} else {
+			length = history_pending.length;
+			events = history_pending.events;
+		}
+		result = rollup == HISTORY_WEEKS
+			? history_add_weeks(fd, &header, events, length, events == history_pending.events ? &backlog : NULL)
+			: history_add_anime(fd, &header, events, length);
+		header.applied += length;
+	}
+	if (history_fd != -1) close(history_fd);
+
+	if (result != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		history_reset_rollup(fd, &header);
+		close(fd);
+		return -1;
+	}
+	return close(fd);
+}
+
+/**
+ * Write pending download events to the history files, must only be called once the anime array is saved
+ * The history file is the record, rollup files that miss events catch up on the next flush
+ * @param dir_fd app subfolder
+ * @param anime_array saved anime array, used to take a snapshot of the backlog
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_flush(int dir_fd, struct json_object * anime_array) {
+	size_t i, n_anime;
+	int new_episodes;
+	uint32_t backlog = 0;
+	uint64_t counted;
+
+	if (history_pending.length == 0) return 0;
+
+	n_anime = json_object_array_length(anime_array);
+	for (i=0; i<n_anime; i++) {
+		new_episodes = get_new_episodes_count(anime_array, i);
+		if (new_episodes > 0) backlog += new_episodes;
+	}
+
+	if (history_append_events(dir_fd, &counted) != 0
+		|| history_update_rollup(dir_fd, HISTORY_WEEKS, counted, backlog) != 0
+		|| history_update_rollup(dir_fd, HISTORY_ANIME, counted, backlog) != 0) {
+		fprintf(stderr, "Failed to record download history\n");
+		return -1;
+	}
+	history_pending.length = 0;
+	return 0;
+}
+
+/**
+ * Helper function to format an average lag as days and hours
+ * @param lag total lag in seconds
+ * @param count number of episodes the lag is summed over
+ * @param buffer where to store the formatted lag
+ * @param size size of the buffer
+ */
+void history_format_lag(int64_t lag, uint64_t count, char * buffer, size_t size) {
+	int64_t average;
+
+	if (count == 0) {
+		snprintf(buffer, size, "-");
+		return;
+	}
+	average = lag / (int64_t) count;
+	snprintf(buffer, size, "%" PRId64 "d %" PRId64 "h %" PRId64 "m", average / DAY_SECONDS, average % DAY_SECONDS / 3600, average % 3600 / 60);
+}
+
+/**
+ * Helper function to find the first event at or after a time in the history file
+ * @param fd history file
+ * @param n_events number of events in the file
+ * @param time time to search for
+ * @param at where to store the index of the first event at or after time
+ * @return 0 on success, otherwise -1 on error
+ */
+int history_lower_bound(int fd, size_t n_events, int64_t time, size_t * at) {
+	size_t low = 0, high = n_events, middle;
+	struct history_event event;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (pread(fd, &event, sizeof(event), sizeof(struct history_header) + middle * sizeof(event)) != sizeof(event)) return -1;
+		if (event.time < time) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*at = low;
+	return 0;
+}
+
+/**
+ * Helper function to print totals of the download events in a date range
+ * Only events inside the range are read, found by binary searching the history file
+ * @param dir_fd app subfolder
+ * @param from start of the range
+ * @param to end of the range, exclusive
+ * @return 0 on success, otherwise -1 on error
+ */
+int print_history_range(int dir_fd, time_t from, time_t to) {
+	size_t i, j, first, last, count;
+	off_t size;
+	uint64_t episodes = 0, lag_episodes = 0;
+	int64_t lag = 0;
+	char lag_string[32], from_string[16], to_string[16];
+	struct history_event events[HISTORY_READ_EVENTS];
+	int fd = history_open(dir_fd, HISTORY_FILENAME, O_RDONLY, HISTORY_MAGIC, sizeof(struct history_event), &size);
+	if (fd == -1) return -1;
+
+	count = (size - sizeof(struct history_header)) / sizeof(struct history_event);
+	if (history_lower_bound(fd, count, from, &first) != 0 || history_lower_bound(fd, count, to, &last) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	for (i=first; i<last; i+=count) {
+		count = last - i < HISTORY_READ_EVENTS ? last - i : HISTORY_READ_EVENTS;
+		if (pread(fd, events, count * sizeof(struct history_event), sizeof(struct history_header) + i * sizeof(struct history_event))
+			!= (ssize_t) (count * sizeof(struct history_event))) {
+			close(fd);
+			return -1;
+		}
+		for (j=0; j<count; j++) {
+			episodes += events[j].to - events[j].from;
+			lag_episodes += events[j].lag_episodes;
+			lag += events[j].lag;
+		}
+	}
+	close(fd);
+
+	to--; // the range end is printed inclusive, as the day of its last second
+	strftime(from_string, sizeof(from_string), "%F", localtime(&from));
+	strftime(to_string, sizeof(to_string), "%F", localtime(&to));
+	history_format_lag(lag, lag_episodes, lag_string, sizeof(lag_string));
+	printf("From %s to %s: %" PRIu64 " episodes in %zu downloads, average lag %s\n", from_string, to_string, episodes, last - first, lag_string);
+	return 0;
+}
+
+/**
+ * Print download statistics: totals, the last weeks with their backlog, and optionally a date range
+ * Totals and weeks are read from the weekly rollups, so it takes the same time however long the history is
+ * @param dir_fd app subfolder, or -1 if it does not exist
+ * @param range whether to print the date range
+ * @param from start of the date range
+ * @param to end of the date range, exclusive
+ * @return 0 on success, otherwise -1 on error
+ */
+int print_stats(int dir_fd, int range, time_t from, time_t to) {
+	int64_t week, current_week;
+	off_t size;
+	time_t week_start;
+	char lag_string[32], week_string[16];
+	struct history_totals totals;
+	struct history_week rollup;
+	int fd = dir_fd == -1 ? -1 : history_open(dir_fd, HISTORY_WEEKS_FILENAME, O_RDONLY, HISTORY_WEEKS_MAGIC, sizeof(struct history_week), &size);
+	if (fd == -1 && dir_fd != -1 && errno != ENOENT) return -1;
+	if (fd == -1 || size == (off_t) sizeof(struct history_header)) { // a file with only a header has no events counted yet
+		if (fd != -1) close(fd);
+		puts("No downloads recorded yet");
+		return 0;
+	}
+
+	if (pread(fd, &totals, sizeof(totals), sizeof(struct history_header)) != sizeof(totals)) {
+		close(fd);
+		return -1;
+	}
+	history_format_lag(totals.lag, totals.lag_episodes, lag_string, sizeof(lag_string));
+	printf("Downloaded %" PRIu64 " episodes in %" PRIu64 " downloads, average lag from airing %s\n", totals.episodes, totals.events, lag_string);
+
+	printf("%-10s | %-8s | %-7s | %s\n", "Week of", "Episodes", "Backlog", "Average lag");
+	current_week = history_week_of(time(NULL));
+	week = current_week - HISTORY_STATS_WEEKS + 1;
+	if (week < totals.first_week) week = totals.first_week;
+	for (; week<=current_week; week++) {
+		memset(&rollup, 0, sizeof(rollup));
+		if (pread(fd, &rollup, sizeof(rollup), sizeof(struct history_header) + sizeof(struct history_totals)
+				  + (week - totals.first_week) * sizeof(struct history_week)) < 0) {
+			close(fd);
+			return -1;
+		}
+		week_start = HISTORY_WEEK_ORIGIN + week * WEEK_SECONDS;
+		strftime(week_string, sizeof(week_string), "%F", gmtime(&week_start));
+		history_format_lag(rollup.lag, rollup.lag_episodes, lag_string, sizeof(lag_string));
+		if (rollup.events == 0) {
+			printf("%-10s | %8u | %7s | %s\n", week_string, 0, "-", lag_string);
+		} else {
+			printf("%-10s | %8u | %7u | %s\n", week_string, rollup.episodes, rollup.backlog, lag_string);
+		}
+	}
+	close(fd);
+
+	if (range) return print_history_range(dir_fd, from, to);
+	return 0;
+}
+
+/**
+ * Print download statistics of one anime from its rollup
+ * Downloads recorded before the anime got an id are kept under its name, so both are looked up
+ * @param dir_fd app subfolder, or -1 if it does not exist
+ * @param anime anime json object
+ * @return 0 on success, otherwise -1 on error
+ */
+int print_anime_stats(int dir_fd, struct json_object * anime) {
+	size_t i, at, capacity;
+	off_t size;
+	time_t last = 0;
+	uint64_t keys[2], episodes = 0, lag_episodes = 0;
+	int64_t lag = 0;
+	char lag_string[32], last_string[32];
+	struct history_anime rollup;
+	struct json_object * name;
+	int fd;
+
+	if (!json_object_object_get_ex(anime, "name", &name)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	fd = dir_fd == -1 ? -1 : history_open(dir_fd, HISTORY_ANIME_FILENAME, O_RDONLY, HISTORY_ANIME_MAGIC, sizeof(struct history_anime), &size);
+	if (fd == -1 && dir_fd != -1 && errno != ENOENT) return -1;
+
+	if (fd != -1) {
+		capacity = (size - sizeof(struct history_header)) / sizeof(struct history_anime);
+		keys[0] = history_anime_key(anime, 0);
+		keys[1] = history_anime_key(anime, 1);
+		for (i=0; i<2 && capacity!=0; i++) {
+			if (i == 1 && keys[1] == keys[0]) break;
+			if (history_anime_find(fd, capacity, keys[i], &at, &rollup) != 0) {
+				close(fd);
+				return -1;
+			}
+			if (rollup.anime == 0) continue;
+			episodes += rollup.episodes;
+			lag_episodes += rollup.lag_episodes;
+			lag += rollup.lag;
+			if (rollup.last > last) last = rollup.last;
+		}
+		close(fd);
+	}
+
+	if (episodes == 0) {
+		printf("No downloads recorded yet for \"%s\"\n", json_object_get_string(name));
+		return 0;
+	}
+	strftime(last_string, sizeof(last_string), "%F %R", localtime(&last));
+	history_format_lag(lag, lag_episodes, lag_string, sizeof(lag_string));
+	printf("\"%s\": downloaded %" PRIu64 " episodes, average lag from airing %s, last download %s\n",
+		   json_object_get_string(name), episodes, lag_string, last_string);
+	return 0;
+}
@@ -0,0 +1,815 @@
+// for timegm
+#define _GNU_SOURCE
+#include <json.h>
+#include <zlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include "../include/anime_functions.h"
+#include "../include/storage.h"
+#include "../include/list_import.h"
+
+#define IMPORT_BUFFER_SIZE 65536
+#define XML_TAG_MAX 64
+#define XML_TEXT_MAX 1024
+#define WEEK_SECONDS (7 * 24 * 60 * 60)
+#define JST_OFFSET_SECONDS (9 * 60 * 60)
+#define COUR_EPISODES 12 // an unknown episode count is assumed to run to the end of the current cour
+
+/**
+ * Open addressing hash set of anime names, used to skip anime that are already in the anime array
+ */
+struct name_index {
+	size_t capacity; // always a power of two
+	size_t count;
+	struct name_index_slot {
+		uint64_t hash;
+		const char * name; // points into a json string owned by the anime array, NULL if the slot is free
+	} * slots;
+};
+
+/**
+ * Anime array being imported into, shared by all export formats
+ */
+struct import_context {
+	struct json_object * anime_array;
+	struct name_index index;
+	size_t added, skipped;
+};
+
+/**
+ * Helper function to hash an anime name, FNV-1a
+ * @param name name to hash
+ * @return 64 bit hash of the name
+ */
+uint64_t name_index_hash(const char * name) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (; *name != '\0'; name++) {
+		hash ^= (unsigned char) *name;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Helper function to find the slot a name is stored in, or should be stored in
+ * @param index index to search
+ * @param name name to look for
+ * @param hash hash of the name
+ * @return slot holding the name, or the free slot to store it in
+ */
+struct name_index_slot * name_index_find(struct name_index * index, const char * name, uint64_t hash) {
+	size_t at = (size_t) hash & (index->capacity - 1);
+
+	while (index->slots[at].name != NULL) {
+		if (index->slots[at].hash == hash && strcmp(index->slots[at].name, name) == 0) break;
+		at = (at + 1) & (index->capacity - 1);
+	}
+	return &index->slots[at];
+}
+
+/**
+ * Helper function to make sure one more name fits into the index, keeping it at most half full
+ * @param index index to grow
+ * @return 0 on success, otherwise -1 on error
+ */
+int name_index_reserve(struct name_index * index) {
+	size_t i, old_capacity = index->capacity;
+	struct name_index_slot * old_slots = index->slots;
+
+	if ((index->count + 1) * 2 <= index->capacity) return 0;
+
+	index->capacity = old_capacity == 0 ? 1024 : old_capacity * 2;
+	index->slots = calloc(index->capacity, sizeof(struct name_index_slot));
+	if (index->slots == NULL) {
+		index->slots = old_slots;
+		index->capacity = old_capacity;
+		return -1;
+	}
+
+	for (i=0; i<old_capacity; i++) {
+		if (old_slots[i].name == NULL) continue;
+		*name_index_find(index, old_slots[i].name, old_slots[i].hash) = old_slots[i];
+	}
+	free(old_slots);
+	return 0;
+}
+
+/**
+ * Helper function to free import context
+ * @param context context to free
+ */
+void import_context_free(struct import_context * context) {
+	free(context->index.slots);
+	context->index.slots = NULL;
+}
+
+/**
+ * Helper function to prepare importing into the anime array, indexing the names of anime already in it
+ * @param context context to initialize, must be freed with import_context_free() on success
+ * @param anime_array anime array to import into
+ * @return 0 on success, otherwise -1 on error, the context is then already freed
+ */
+int import_context_init(struct import_context * context, struct json_object * anime_array) {
+	size_t i, n_anime;
+	uint64_t hash;
+	const char * name;
+	struct json_object * anime_name;
+	struct name_index_slot * slot;
+
+	memset(context, 0, sizeof(struct import_context));
+	context->anime_array = anime_array;
+
+	n_anime = json_object_array_length(anime_array);
+	for (i=0; i<n_anime; i++) {
+		if (!json_object_object_get_ex(json_object_array_get_idx(anime_array, i), "name", &anime_name)) {
+			fprintf(stderr, "Malformed json\n");
+			import_context_free(context);
+			return -1;
+		}
+		if (name_index_reserve(&context->index) != 0) {
+			import_context_free(context);
+			return -1;
+		}
+		name = json_object_get_string(anime_name);
+		hash = name_index_hash(name);
+		slot = name_index_find(&context->index, name, hash);
+		if (slot->name != NULL) continue;
+		slot->hash = hash;
+		slot->name = name;
+		context->index.count++;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to add an imported anime to the anime array, unless an anime with the same name is already there
+ * Exports leave the episode count of airing anime unknown, it is then set to the end of the current cour.
+ * An unknown start date is set so that the last watched episode aired at import time.
+ * Both are reported, so they can be edited once known.
+ * @param context import context
+ * @param name anime name
+ * @param episodes anime's episode count, 0 if unknown
+ * @param aired episodes known to have aired, 0 if unknown
+ * @param watched episodes already watched
+ * @param start_date anime's broadcast start date, 0 if unknown
+ * @param ignored whether the anime should be marked as ignored
+ * @return 0 on success, otherwise -1 on error
+ */
+int import_add(struct import_context * context, const char * name, size_t episodes, size_t aired, size_t watched,
+			   time_t start_date, int ignored) {
+	uint64_t hash;
+	size_t known;
+	struct name_index_slot * slot;
+	struct json_object * anime;
+	struct json_object * anime_name;
+	struct json_object * anime_episodes_downloaded;
+	struct json_object * anime_ignored;
+
+	if (name[0] == '\0') {
+		context->skipped++;
+		return 0;
+	}
+	if (name_index_reserve(&context->index) != 0) return -1;
+
+	hash = name_index_hash(name);
+	slot = name_index_find(&context->index, name, hash);
+	if (slot->name != NULL) {
+		context->skipped++;
+		return 0;
+	}
+
+	if (episodes == 0) {
+		known = watched > aired ? watched : aired;
+		episodes = (known / COUR_EPISODES + 1) * COUR_EPISODES;
+		fprintf(stderr, "Episode count of '%s' is unknown, set to %zu\n", name, episodes);
+	}
+	if (watched > episodes) watched = episodes;
+	if (start_date == 0) {
+		start_date = time(NULL) - (time_t) (watched > 1 ? watched - 1 : 0) * WEEK_SECONDS;
+		fprintf(stderr, "Start date of '%s' is unknown, set so that episode %zu aired today\n", name, watched > 1 ? watched : 1);
+	}
+
+	anime = make_anime_json_object((char *) name, episodes, start_date);
+	if (anime == NULL) {
+		fprintf(stderr, "Failed to create anime '%s'\n", name);
+		return -1;
+	}
+	json_object_object_get_ex(anime, "episodes_downloaded", &anime_episodes_downloaded);
+	json_object_set_uint64(anime_episodes_downloaded, watched);
+	json_object_object_get_ex(anime, "ignored", &anime_ignored);
+	json_object_set_boolean(anime_ignored, ignored);
+	json_object_array_add(context->anime_array, anime);
+
+	// the name is kept alive by the anime array
+	json_object_object_get_ex(anime, "name", &anime_name);
+	slot->hash = hash;
+	slot->name = json_object_get_string(anime_name);
+	context->index.count++;
+	context->added++;
+	return 0;
+}
+
+/**
+ * Helper function to convert a date in JST to unix time
+ * @param year year, dates before 1970 are treated as unknown
+ * @param month month, starting from 1
+ * @param day day of the month, starting from 1
+ * @return unix time of the start of the day in JST, or 0 if the date is unknown
+ */
+time_t jst_date_to_unix(int year, int month, int day) {
+	struct tm date;
+
+	if (year < 1970) return 0;
+	memset(&date, 0, sizeof(struct tm));
+	date.tm_year = year - 1900;
+	date.tm_mon = month > 0 ? month - 1 : 0;
+	date.tm_mday = day > 0 ? day : 1;
+	return timegm(&date) - JST_OFFSET_SECONDS;
+}
+
+/**
+ * Detect which export file format a file is in by its first significant character
+ * @param filepath file to check, may be gzip compressed
+ * @param method where to store the method to import the file with
+ * @return 0 on success, otherwise -1 if the file can't be read or the format is not recognized
+ */
+int detect_export_method(const char * filepath, enum ADD_ANIME_METHOD * method) {
+	int c;
+	gzFile file = storage_open_read(AT_FDCWD, filepath);
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open the file for reading\n");
+		return -1;
+	}
+
+	do {
+		c = gzgetc(file);
+	} while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0xef || c == 0xbb || c == 0xbf); // 0xefbbbf is utf-8 BOM
+	gzclose(file);
+
+	if (c == '<') {
+		*method = MAL_EXPORT;
+	} else if (c == '{' || c == '[') {
+		*method = ANILIST_EXPORT;
+	} else {
+		fprintf(stderr, "Unknown export file format, expected MyAnimeList xml or AniList json\n");
+		return -1;
+	}
+	return 0;
+}
+
+enum XML_STATE {
+	XML_TEXT,
+	XML_TAG_NAME,
+	XML_TAG_REST,   // attributes, skipped
+	XML_CDATA,
+	XML_COMMENT,
+	XML_SKIP,       // processing instructions and declarations, skipped
+};
+
+/**
+ * State of the streaming MyAnimeList xml parser, fed one buffer at a time
+ */
+struct mal_parser {
+	struct import_context * context;
+	enum XML_STATE state;
+	char tag[XML_TAG_MAX];
+	size_t tag_length;
+	int closing, self_closing;
+	char text[XML_TEXT_MAX];
+	size_t text_length;
+	int text_cdata; // CDATA text is taken literally, without decoding entities
+	size_t pending; // ']' in CDATA or '-' in comments that might be part of the terminator
+	int in_anime;
+	// anime being parsed
+	char name[XML_TEXT_MAX];
+	size_t episodes, watched;
+	time_t start_date;
+	int ignored;
+};
+
+/**
+ * Helper function to append a character to the text of the current xml element
+ * @param parser parser
+ * @param c character to append, text longer than the buffer is truncated
+ */
+void mal_parser_append(struct mal_parser * parser, char c) {
+	if (parser->in_anime && parser->text_length < XML_TEXT_MAX - 1) parser->text[parser->text_length++] = c;
+}
+
+/**
+ * Helper function to replace xml entities in a string with the characters they stand for
+ * @param text null terminated string to decode in place
+ */
+void xml_decode_entities(char * text) {
+	static const struct {
+		const char * entity;
+		char c;
+	} entities[] = {{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+	char * in = text;
+	char * out = text;
+	char * end;
+	unsigned long codepoint;
+	size_t i, length;
+
+	while (*in != '\0') {
+		if (*in != '&') {
+			*out++ = *in++;
+			continue;
+		}
+
+		if (in[1] == '#') {
+			codepoint = (in[2] == 'x' || in[2] == 'X') ? strtoul(in + 3, &end, 16) : strtoul(in + 2, &end, 10);
+			if (*end == ';' && codepoint > 0 && codepoint <= 0x10ffff) {
+				// encode as utf-8
+				if (codepoint < 0x80) {
+					*out++ = (char) codepoint;
+				} else if (codepoint < 0x800) {
+					*out++ = (char) (0xc0 | (codepoint >> 6));
+					*out++ = (char) (0x80 | (codepoint & 0x3f));
+				} else if (codepoint < 0x10000) {
+					*out++ = (char) (0xe0 | (codepoint >> 12));
+					*out++ = (char) (0x80 | ((codepoint >> 6) & 0x3f));
+					*out++ = (char) (0x80 | (codepoint & 0x3f));
+				} else {
+					*out++ = (char) (0xf0 | (codepoint >> 18));
+					*out++ = (char) (0x80 | ((codepoint >> 12) & 0x3f));
+					*out++ = (char) (0x80 | ((codepoint >> 6) & 0x3f));
+					*out++ = (char) (0x80 | (codepoint & 0x3f));
+				}
+				in = end + 1;
+				continue;
+			}
+		}
+
+		for (i=0; i<sizeof(entities)/sizeof(entities[0]); i++) {
+			length = strlen(entities[i].entity);
+			if (strncmp(in, entities[i].entity, length) == 0) break;
+		}
+		if (i < sizeof(entities)/sizeof(entities[0])) {
+			*out++ = entities[i].c;
+			in += length;
+		} else {
+			*out++ = *in++;
+		}
+	}
+	*out = '\0';
+}
+
+/**
+ * Helper function to handle a complete xml tag
+ * @param parser parser, the tag name is in parser->tag
+ * @return 0 on success, otherwise -1 on error
+ */
+int mal_parser_tag(struct mal_parser * parser) {
+	int year, month, day;
+	char * text = parser->text;
+
+	parser->tag[parser->tag_length] = '\0';
+	parser->text[parser->text_length] = '\0';
+
+	if (!parser->closing) {
+		if (strcmp(parser->tag, "anime") == 0) {
+			parser->in_anime = 1;
+			parser->name[0] = '\0';
+			parser->episodes = 0;
+			parser->watched = 0;
+			parser->start_date = 0;
+			parser->ignored = 0;
+		}
+		parser->text_length = 0;
+		parser->text_cdata = 0;
+		if (!parser->self_closing) return 0;
+	}
+	parser->text_length = 0;
+	parser->text_cdata = 0;
+	if (!parser->in_anime) return 0;
+
+	while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+
+	if (strcmp(parser->tag, "anime") == 0) {
+		parser->in_anime = 0;
+		return import_add(parser->context, parser->name, parser->episodes, 0, parser->watched,
+						  parser->start_date, parser->ignored);
+	} else if (strcmp(parser->tag, "series_title") == 0) {
+		if (!parser->text_cdata) xml_decode_entities(text);
+		memcpy(parser->name, text, strlen(text) + 1);
+	} else if (strcmp(parser->tag, "series_episodes") == 0) {
+		parser->episodes = strtoul(text, NULL, 10);
+	} else if (strcmp(parser->tag, "my_watched_episodes") == 0) {
+		parser->watched = strtoul(text, NULL, 10);
+	} else if (strcmp(parser->tag, "my_start_date") == 0) {
+		// the export has no broadcast date, the date the user started watching is the closest approximation
+		if (sscanf(text, "%d-%d-%d", &year, &month, &day) == 3) parser->start_date = jst_date_to_unix(year, month, day);
+	} else if (strcmp(parser->tag, "my_status") == 0) {
+		parser->ignored = strncmp(text, "On-Hold", 7) == 0 || strncmp(text, "Dropped", 7) == 0
+						  || strncmp(text, "Plan to Watch", 13) == 0
+						  || strcmp(text, "3") == 0 || strcmp(text, "4") == 0 || strcmp(text, "6") == 0;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to feed a buffer of xml to the parser
+ * @param parser parser
+ * @param buffer xml data
+ * @param length length of the data
+ * @return 0 on success, otherwise -1 on error
+ */
+int mal_parser_feed(struct mal_parser * parser, const char * buffer, size_t length) {
+	size_t i;
+	char c;
+
+	for (i=0; i<length; i++) {
+		c = buffer[i];
+		switch (parser->state) {
+			case XML_TEXT:
+				if (c == '<') {
+					parser->state = XML_TAG_NAME;
+					parser->tag_length = 0;
+					parser->closing = 0;
+					parser->self_closing = 0;
+				} else {
+					mal_parser_append(parser, c);
+				}
+				break;
+			case XML_TAG_NAME:
+				if (parser->tag_length == 0 && c == '/') {
+					parser->closing = 1;
+				} else if (parser->tag_length == 0 && c == '?') {
+					parser->state = XML_SKIP;
+				} else if (c == '>') {
+					parser->state = XML_TEXT;
+					if (mal_parser_tag(parser) != 0) return -1;
+				} else if (c == '/') {
+					parser->self_closing = 1;
+				} else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+					parser->state = XML_TAG_REST;
+				} else if (parser->tag_length < XML_TAG_MAX - 1) {
+					parser->tag[parser->tag_length++] = c;
+					if (parser->tag_length == 3 && memcmp(parser->tag, "!--", 3) == 0) {
+						parser->state = XML_COMMENT;
+						parser->pending = 0;
+					} else if (parser->tag_length == 8 && memcmp(parser->tag, "![CDATA[", 8) == 0) {
+						parser->state = XML_CDATA;
+						parser->text_cdata = 1;
+						parser->pending = 0;
+					} else if (parser->tag_length == 2 && parser->tag[0] == '!' && parser->tag[1] != '-' && parser->tag[1] != '[') {
+						parser->state = XML_SKIP;
+					}
+				}
+				break;
+			case XML_TAG_REST:
+				if (c == '/') {
+					parser->self_closing = 1;
+				} else if (c == '>') {
+					parser->state = XML_TEXT;
+					if (mal_parser_tag(parser) != 0) return -1;
+				} else {
+					parser->self_closing = 0;
+				}
+				break;
+			case XML_CDATA:
+				if (c == ']') {
+					parser->pending++;
+				} else if (c == '>' && parser->pending >= 2) {
+					for (; parser->pending > 2; parser->pending--) mal_parser_append(parser, ']');
+					parser->state = XML_TEXT;
+				} else {
+					for (; parser->pending > 0; parser->pending--) mal_parser_append(parser, ']');
+					mal_parser_append(parser, c);
+				}
+				break;
+			case XML_COMMENT:
+				if (c == '-') {
+					parser->pending++;
+				} else {
+					if (c == '>' && parser->pending >= 2) parser->state = XML_TEXT;
+					parser->pending = 0;
+				}
+				break;
+			case XML_SKIP:
+				if (c == '>') parser->state = XML_TEXT;
+				break;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Import anime from a MyAnimeList xml export file, parsed as it is read
+ * All anime are added to the anime array in memory, so saving it once commits the whole import
+ * @param anime_array anime array to add anime to, anime with names already in it are skipped
+ * @param filepath export file to import, may be gzip compressed
+ * @return 0 on success, otherwise -1 on error
+ */
+int add_anime_from_mal_export(struct json_object * anime_array, const char * filepath) {
+	int read, return_code = 0;
+	char * buffer;
+	struct import_context context;
+	struct mal_parser * parser;
+	gzFile file;
+
+	file = storage_open_read(AT_FDCWD, filepath);
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open the file for reading\n");
+		return -1;
+	}
+
+	buffer = malloc(IMPORT_BUFFER_SIZE);
+	parser = calloc(1, sizeof(struct mal_parser));
+	if (buffer == NULL || parser == NULL || import_context_init(&context, anime_array) != 0) {
+		free(buffer);
+		free(parser);
+		gzclose(file);
+		return -1;
+	}
+	parser->context = &context;
+	parser->state = XML_TEXT;
+
+	while ((read = gzread(file, buffer, IMPORT_BUFFER_SIZE)) > 0) {
+		if (mal_parser_feed(parser, buffer, (size_t) read) != 0) {
+			return_code = -1;
+			break;
+		}
+	}
+	if (read < 0) {
+		fprintf(stderr, "Failed to read file: %s\n", gzerror(file, &read));
+		return_code = -1;
+	}
+
+	if (return_code == 0) printf("Added %zu anime, skipped %zu already present\n", context.added, context.skipped);
+
+	import_context_free(&context);
+	free(parser);
+	free(buffer);
+	gzclose(file);
+	return return_code;
+}
+
+/**
+ * Helper function to get a member of a json object
+ * @param object object to get the member of, may be NULL
+ * @param key member name
+ * @return the member, or NULL if there is no such member or it is null
+ */
+struct json_object * anilist_get(struct json_object * object, const char * key) {
+	struct json_object * member;
+	if (!json_object_is_type(object, json_type_object)) return NULL;
+	if (!json_object_object_get_ex(object, key, &member)) return NULL;
+	return member;
+}
+
+/**
+ * Helper function to import a single AniList media list entry
+ * @param context import context
+ * @param entry media list entry, with the media under "media"
+ * @return 0 on success, otherwise -1 on error
+ */
+int anilist_import_entry(struct import_context * context, struct json_object * entry) {
+	static const char * title_keys[] = {"userPreferred", "romaji", "english", "native"};
+	size_t i;
+	int64_t episode = 0;
+	time_t start_date = 0;
+	const char * name = "";
+	const char * status;
+	struct json_object * media;
+	struct json_object * title;
+	struct json_object * member;
+	struct json_object * airing;
+	struct json_object * date;
+
+	media = anilist_get(entry, "media");
+	if (media == NULL) media = entry;
+
+	title = anilist_get(media, "title");
+	if (json_object_is_type(title, json_type_string)) {
+		name = json_object_get_string(title);
+	} else {
+		for (i=0; i<sizeof(title_keys)/sizeof(title_keys[0]); i++) {
+			member = anilist_get(title, title_keys[i]);
+			if (json_object_is_type(member, json_type_string)) {
+				name = json_object_get_string(member);
+				break;
+			}
+		}
+	}
+
+	// the next airing episode pins down the exact weekly broadcast time, the start date only the day
+	airing = anilist_get(media, "nextAiringEpisode");
+	date = anilist_get(media, "startDate");
+	if (anilist_get(airing, "airingAt") != NULL) {
+		episode = json_object_get_int64(anilist_get(airing, "episode"));
+		start_date = (time_t) json_object_get_int64(anilist_get(airing, "airingAt"))
+					 - (time_t) (episode > 1 ? episode - 1 : 0) * WEEK_SECONDS;
+	} else if (date != NULL) {
+		start_date = jst_date_to_unix(json_object_get_int(anilist_get(date, "year")),
+									  json_object_get_int(anilist_get(date, "month")),
+									  json_object_get_int(anilist_get(date, "day")));
+	}
+
+	status = json_object_get_string(anilist_get(entry, "status"));
+	return import_add(context, name,
+					  (size_t) json_object_get_uint64(anilist_get(media, "episodes")),
+					  (size_t) (episode > 1 ? episode - 1 : 0),
+					  (size_t) json_object_get_uint64(anilist_get(entry, "progress")),
+					  start_date,
+					  status != NULL && (strcmp(status, "PLANNING") == 0 || strcmp(status, "DROPPED") == 0
+										 || strcmp(status, "PAUSED") == 0));
+}
+
+/**
+ * State of the streaming AniList json scanner, fed one buffer at a time
+ * The scanner only tracks nesting to find media list entries, every entry is parsed by json-c on its own,
+ * so no more than one entry is ever held in memory
+ */
+struct anilist_parser {
+	struct import_context * context;
+	json_tokener * tokener;
+	int depth; // nesting depth of objects and arrays
+	int in_string, escaped;
+	char key[XML_TAG_MAX]; // last string, truncated, used to spot "entries" keys
+	size_t key_length;
+	int after_string; // the last token was a string, a ':' next makes it a key
+	int entries_key; // the last key was "entries" and its value hasn't started yet
+	int root_array; // the export is an array of lists or entries, instead of a query result
+	int entries_depth; // depth of the entries array being walked, 0 if none
+	int entry_depth; // depth of the entry being parsed, 0 if none
+	int entry_in_root; // the entry is an element of the root array, it is a list if it has entries of its own
+	int found; // media lists were found
+};
+
+/**
+ * Helper function to feed part of an entry to json-c, importing it once complete
+ * @param parser parser
+ * @param buffer json of the entry
+ * @param length length of the json
+ * @param complete whether this is the end of the entry
+ * @return 0 on success, otherwise -1 on error
+ */
+int anilist_parser_entry(struct anilist_parser * parser, const char * buffer, size_t length, int complete) {
+	int return_code;
+	enum json_tokener_error error;
+	struct json_object * entry = json_tokener_parse_ex(parser->tokener, buffer, (int) length);
+
+	error = json_tokener_get_error(parser->tokener);
+	if (complete ? error != json_tokener_success : error != json_tokener_continue) {
+		fprintf(stderr, "Failed to parse AniList export: %s\n", json_tokener_error_desc(error));
+		json_object_put(entry);
+		return -1;
+	}
+	if (!complete) return 0;
+
+	json_tokener_reset(parser->tokener);
+	return_code = anilist_import_entry(parser->context, entry);
+	json_object_put(entry);
+	return return_code;
+}
+
+/**
+ * Helper function to feed a buffer of json to the parser
+ * Media list entries are elements of "entries" arrays, or of the root array if it is a plain array of entries
+ * @param parser parser
+ * @param buffer json data
+ * @param length length of the data
+ * @return 0 on success, otherwise -1 on error
+ */
+int anilist_parser_feed(struct anilist_parser * parser, const char * buffer, size_t length) {
+	size_t i, entry_at = 0; // where the part of the entry in this buffer starts
+	char c;
+
+	for (i=0; i<length; i++) {
+		c = buffer[i];
+		if (parser->in_string) {
+			if (parser->escaped) {
+				parser->escaped = 0;
+			} else if (c == '\\') {
+				parser->escaped = 1;
+			} else if (c == '"') {
+				parser->in_string = 0;
+				parser->after_string = 1;
+				continue;
+			}
+			if (parser->key_length < XML_TAG_MAX - 1) parser->key[parser->key_length++] = c;
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+
+		if (c == ':') {
+			parser->entries_key = parser->after_string && parser->key_length == 7 && memcmp(parser->key, "entries", 7) == 0;
+			parser->after_string = 0;
+			continue;
+		}
+		parser->after_string = 0;
+
+		if (c == '"') {
+			parser->in_string = 1;
+			parser->key_length = 0;
+		} else if (c == '[') {
+			parser->depth++;
+			if (parser->depth == 1) {
+				parser->root_array = 1;
+				parser->found = 1;
+			}
+			// entries of a root array element make it a list instead of an entry
+			if (parser->entries_key && (parser->entry_depth == 0 || (parser->entry_in_root && parser->depth == parser->entry_depth + 1))) {
+				if (parser->entry_depth != 0) {
+					parser->entry_depth = 0;
+					json_tokener_reset(parser->tokener);
+				}
+				parser->entries_depth = parser->depth;
+				parser->found = 1;
+			}
+		} else if (c == '{') {
+			parser->depth++;
+			if (parser->entry_depth == 0
+				&& ((parser->entries_depth != 0 && parser->depth == parser->entries_depth + 1)
+					|| (parser->root_array && parser->entries_depth == 0 && parser->depth == 2))) {
+				parser->entry_depth = parser->depth;
+				parser->entry_in_root = parser->entries_depth == 0;
+				entry_at = i;
+			}
+		} else if (c == '}') {
+			if (parser->entry_depth == parser->depth) {
+				parser->entry_depth = 0;
+				if (anilist_parser_entry(parser, buffer + entry_at, i + 1 - entry_at, 1) != 0) return -1;
+			}
+			parser->depth--;
+		} else if (c == ']') {
+			if (parser->entries_depth == parser->depth) parser->entries_depth = 0;
+			parser->depth--;
+		}
+		parser->entries_key = 0;
+		if (parser->depth < 0) {
+			fprintf(stderr, "Failed to parse AniList export: unbalanced brackets\n");
+			return -1;
+		}
+	}
+
+	// the rest of the entry is in the next buffer
+	if (parser->entry_depth != 0 && anilist_parser_entry(parser, buffer + entry_at, length - entry_at, 0) != 0) return -1;
+	return 0;
+}
+
+/**
+ * Import anime from an AniList json export file, parsed one media list entry at a time as it is read
+ * Accepts the MediaListCollection query result, either whole or just its lists, or a plain array of entries
+ * All anime are added to the anime array in memory, so saving it once commits the whole import
+ * @param anime_array anime array to add anime to, anime with names already in it are skipped
+ * @param filepath export file to import, may be gzip compressed
+ * @return 0 on success, otherwise -1 on error
+ */
+int add_anime_from_anilist_export(struct json_object * anime_array, const char * filepath) {
+	int read, return_code = 0;
+	char * buffer;
+	struct import_context context;
+	struct anilist_parser * parser;
+	gzFile file;
+
+	file = storage_open_read(AT_FDCWD, filepath);
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open the file for reading\n");
+		return -1;
+	}
+
+	buffer = malloc(IMPORT_BUFFER_SIZE);
+	parser = calloc(1, sizeof(struct anilist_parser));
+	if (buffer == NULL || parser == NULL || (parser->tokener = json_tokener_new()) == NULL
+		|| import_context_init(&context, anime_array) != 0) {
+		if (parser != NULL && parser->tokener != NULL) json_tokener_free(parser->tokener);
+		free(buffer);
+		free(parser);
+		gzclose(file);
+		return -1;
+	}
+	parser->context = &context;
+
+	while ((read = gzread(file, buffer, IMPORT_BUFFER_SIZE)) > 0) {
+		if (anilist_parser_feed(parser, buffer, (size_t) read) != 0) {
+			return_code = -1;
+			break;
+		}
+	}
+	if (read < 0) {
+		fprintf(stderr, "Failed to read file: %s\n", gzerror(file, &read));
+		return_code = -1;
+	} else if (return_code == 0 && (parser->depth != 0 || parser->in_string)) {
+		fprintf(stderr, "Failed to parse AniList export: unexpected end of file\n");
+		return_code = -1;
+	} else if (return_code == 0 && !parser->found) {
+		fprintf(stderr, "Failed to find media lists in AniList export\n");
+		return_code = -1;
+	}
+
+	if (return_code == 0) printf("Added %zu anime, skipped %zu already present\n", context.added, context.skipped);
+
+	import_context_free(&context);
+	json_tokener_free(parser->tokener);
+	free(parser);
+	free(buffer);
+	gzclose(file);
+	return return_code;
+}
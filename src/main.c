@@ -1,14 +1,42 @@
+// for O_PATH
+#define _GNU_SOURCE
 #include <json.h>
+#include <zlib.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include "../include/anime_functions.h"
+#include "../include/template.h"
+#include "../include/storage.h"
+#include "../include/list_import.h"
+#include "../include/sync.h"
+#include "../include/query.h"
+#include "../include/history.h"
+#include "../include/probes.h"
 
-#define XDG_CONFIG_HOME_DEFAULT "~/.config"
+#define XDG_CONFIG_HOME_DEFAULT "/.config" // relative to HOME
 #define APP_SUBFOLDER "/aweek"
-#define SAVED_ANIME_FILENAME "/anime.json"
+#define SAVED_ANIME_FILENAME "anime.json" // relative to the app subfolder
+
+#ifdef AWEEK_PROBES
+PROBE_SEMAPHORE(dispatch__start);
+PROBE_SEMAPHORE(dispatch__done);
+PROBE_SEMAPHORE(load__start);
+PROBE_SEMAPHORE(load__done);
+PROBE_SEMAPHORE(parse__start);
+PROBE_SEMAPHORE(parse__done);
+PROBE_SEMAPHORE(new_episodes__start);
+PROBE_SEMAPHORE(new_episodes__done);
+PROBE_SEMAPHORE(list__start);
+PROBE_SEMAPHORE(list__done);
+PROBE_SEMAPHORE(save__start);
+PROBE_SEMAPHORE(save__done);
+#endif
 
 #define APP_NAME "aweek"
 #define VERSION "1.0.0{GIT-COMMIT}"
@@ -33,137 +61,491 @@ int print_help() {
 	fprintf(stdout, "Usage:\n");
 	fprintf(stdout, "\t" APP_NAME "													 list new episodes\n");
 	fprintf(stdout, "\t" APP_NAME " (a)dd											 add anime\n");
+	fprintf(stdout, "\t" APP_NAME " (a)dd		 <export_file>						 add anime from MyAnimeList xml or AniList json export\n");
 	fprintf(stdout, "\t" APP_NAME " (d)elete	 <anime_id>							 delete anime\n");
 	fprintf(stdout, "\t" APP_NAME " (u)pdate	 <anime_id> <downloaded_episodes>	 update anime's downloaded episodes count\n");
 	fprintf(stdout, "\t" APP_NAME " (e)dit		 <anime_id>							 edit anime\n");
 	fprintf(stdout, "\t" APP_NAME " (i)gnore	 <anime_id>							 toggle ignored flag for anime\n");
-	fprintf(stdout, "\t" APP_NAME " (l)ist											 list all anime\n");
+	fprintf(stdout, "\t" APP_NAME " (l)ist		 [options]							 list all anime, see list options below\n");
 	fprintf(stdout, "\t" APP_NAME " (n)ew-episodes-count							 show the number of new episodes\n");
+	fprintf(stdout, "\t" APP_NAME " --template	 <template>							 list new episodes using a template\n");
+	fprintf(stdout, "\t" APP_NAME " export		 <file> [json|cbor][.gz]			 export anime to a file, json by default\n");
+	fprintf(stdout, "\t" APP_NAME " import		 <file>								 replace anime with ones from a file, keeping its format\n");
+	fprintf(stdout, "\t" APP_NAME " set		 --where <query> <field=value>...	 set fields of every anime matching the query\n");
+	fprintf(stdout, "\t" APP_NAME " sync		 <folder>							 merge anime with another machine's aweek folder\n");
+	fprintf(stdout, "\t" APP_NAME " stats		 [--from <date>] [--to <date>]		 show download statistics, dates are YYYY-MM-DD\n");
+	fprintf(stdout, "\t" APP_NAME " stats		 <anime_id>							 show download statistics for anime\n");
 	fprintf(stdout, "\t" APP_NAME " (v)ersion										 print version information\n");
 	fprintf(stdout, "\t" APP_NAME " anything else									 print this help page\n");
+	fprintf(stdout, "\nList options:\n");
+	fprintf(stdout, "\t--sort=<none|name|next-airing|remaining|start>		 sort anime, file order by default\n");
+	fprintf(stdout, "\t--filter=<airing,finished,ignored,has-new>			 list only anime matching all filters\n");
+	fprintf(stdout, "\t--limit <count> --offset <count>					 list a page of anime\n");
+	fprintf(stdout, "\nQueries:\n");
+	fprintf(stdout, "\tname episodes episodes_downloaded start_date ignored aired new		 fields, only the first five can be set\n");
+	fprintf(stdout, "\tdelayed_episodes=<episode,...>						 can be set, but not queried\n");
+	fprintf(stdout, "\t== != < <= > >= ! && || ( ) \"string\" 42 true false		 e.g. 'episodes_downloaded == episodes && !ignored'\n");
+	fprintf(stdout, "\nTemplate placeholders:\n");
+	fprintf(stdout, "\t{count} {anime}									 total new episodes, anime with new episodes\n");
+	fprintf(stdout, "\t{id} {name} {episode} {new} {downloaded} {episodes}	 new episode information\n");
+	fprintf(stdout, "\t{#items}...{/items}								 repeated for every new episode\n");
+	fprintf(stdout, "\t{^items}...{/items}								 printed only if there are no new episodes\n");
 	return 0;
 }
 
 /**
- * Get filepath to the file used to save anime array
- * Creates folders if necessary, respects XDG Base Directory
- * @return filepath to use when saving anime array, or NULL on error
+ * Folder used to save anime array
  */
-char* get_save_anime_filepath() {
-	char * config_filepath = getenv("XDG_CONFIG_HOME");
-	if (config_filepath == NULL) {
-		config_filepath = XDG_CONFIG_HOME_DEFAULT;
-	}
-	size_t config_filepath_len = sizeof(char) * strlen(config_filepath);
-	size_t app_subfolder_len = sizeof(char) * strlen(APP_SUBFOLDER);
-	size_t saved_anime_filename_len = sizeof(char) * strlen(SAVED_ANIME_FILENAME);
-	size_t written = 0;
-	struct stat sb;
-
-	char * filepath = malloc(config_filepath_len + app_subfolder_len + saved_anime_filename_len + 1);
-	if (filepath == NULL)  return NULL;
-
-	memcpy(filepath, config_filepath, config_filepath_len);
-	written += config_filepath_len;
-	filepath[written] = '\0';
-	if (stat(filepath, &sb) != 0 || !S_ISDIR(sb.st_mode)) {
-		fprintf(stderr, "XDG_CONFIG_HOME does not exist!\n");
-		free(filepath);
-		return NULL;
-	}
+struct save_folder {
+	char * path; // app subfolder in XDG_CONFIG_HOME
+	int fd; // O_PATH descriptor of the app subfolder, -1 until it exists
+};
 
-	memcpy(filepath+written, APP_SUBFOLDER, app_subfolder_len);
-	written += app_subfolder_len;
-	filepath[written] = '\0';
-	if (stat(filepath, &sb) !=0 || !S_ISDIR(sb.st_mode)) {
-		// creating app subfolder in XDG_CONFIG_HOME
-		if (mkdir(filepath, 0755) == -1) {
-			fprintf(stderr, "Failed to create app subfolder\n");
-			free(filepath);
-			return NULL;
+/**
+ * Resolve and open the folder used to save anime array, respects XDG Base Directory
+ * The folder is not created here, see create_save_folder(), a missing folder is reported through fd being -1
+ * @param folder where to store the folder information, must be closed with close_save_folder()
+ * @return 0 on success, otherwise -1 on error
+ */
+int open_save_folder(struct save_folder * folder) {
+	const char * config_filepath = getenv("XDG_CONFIG_HOME");
+	const char * config_suffix = "";
+	if (config_filepath == NULL || config_filepath[0] != '/') { // relative paths are invalid as per specification
+		config_filepath = getenv("HOME");
+		config_suffix = XDG_CONFIG_HOME_DEFAULT;
+		if (config_filepath == NULL) {
+			fprintf(stderr, "Neither XDG_CONFIG_HOME nor HOME is set!\n");
+			return -1;
 		}
 	}
+	size_t config_filepath_len = strlen(config_filepath);
+	size_t config_suffix_len = strlen(config_suffix);
+	size_t app_subfolder_len = strlen(APP_SUBFOLDER);
 
-	memcpy(filepath+written, SAVED_ANIME_FILENAME, saved_anime_filename_len);
-	written += saved_anime_filename_len;
-	filepath[written] = '\0';
+	folder->fd = -1;
+	folder->path = malloc(config_filepath_len + config_suffix_len + app_subfolder_len + 1);
+	if (folder->path == NULL) return -1;
 
-	if (access(filepath, F_OK|R_OK|W_OK) != 0 && access(filepath, F_OK) == 0) {
-		fprintf(stderr, "Anime file is not readable or writable\n");
-		free(filepath);
-		return NULL;
+	memcpy(folder->path, config_filepath, config_filepath_len);
+	memcpy(folder->path + config_filepath_len, config_suffix, config_suffix_len);
+	memcpy(folder->path + config_filepath_len + config_suffix_len, APP_SUBFOLDER, app_subfolder_len + 1);
+
+	// a single open() both checks that the folder exists and gives a base for openat()
+	folder->fd = open(folder->path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (folder->fd == -1 && errno != ENOENT) {
+		fprintf(stderr, "Failed to open app subfolder\n");
+		free(folder->path);
+		return -1;
 	}
 
-	return filepath;
+	return 0;
 }
 
 /**
- * Load anime array from json file
- * @param filepath file to load anime array from
- * @return pointer to json object representing anime array, or NULL on error
+ * Create the folder used to save anime array if it does not exist yet, only needed before the first write
+ * @param folder folder opened with open_save_folder()
+ * @return 0 on success, otherwise -1 on error
  */
-struct json_object * load_saved_anime(char* filepath) {
-	struct stat sb;
-	if (stat(filepath, &sb) != 0) { // file does not exist
-		return json_object_new_array_ext(1);
-	}
-
-	char * buffer = malloc(sb.st_size + 1);
-	if (buffer == NULL) return NULL;
-	buffer[sb.st_size] = '\0';
+int create_save_folder(struct save_folder * folder) {
+	if (folder->fd != -1) return 0;
 
-	FILE * file = fopen(filepath, "r");
-	if (file == NULL) {
-		fprintf(stderr, "Failed to open the file for reading\n");
-		free(buffer);
-		return NULL;
+	if (mkdir(folder->path, 0755) == -1 && errno != EEXIST) {
+		if (errno == ENOENT) {
+			fprintf(stderr, "XDG_CONFIG_HOME does not exist!\n");
+		} else {
+			fprintf(stderr, "Failed to create app subfolder\n");
+		}
+		return -1;
 	}
-	if (fread(buffer, sb.st_size, 1, file) != 1) {
-		fprintf(stderr, "Failed to read file\n");
-		fclose(file);
-		free(buffer);
-		return NULL;
+
+	folder->fd = open(folder->path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (folder->fd == -1) {
+		fprintf(stderr, "Failed to open app subfolder\n");
+		return -1;
 	}
-	fclose(file);
+	return 0;
+}
 
+/**
+ * Close the folder used to save anime array
+ * @param folder folder opened with open_save_folder()
+ */
+void close_save_folder(struct save_folder * folder) {
+	if (folder->fd != -1) close(folder->fd);
+	free(folder->path);
+}
+
+/**
+ * Read anime array from an already opened file
+ * @param file file to read anime array from
+ * @param format where to store the storage format the file is in
+ * @return pointer to json object representing anime array, or NULL on error
+ */
+struct json_object * read_anime_file(gzFile file, struct storage_format * format) {
 	struct json_object * anime_array;
-	anime_array = json_tokener_parse(buffer);
-	free(buffer);
+	anime_array = storage_read(file, format);
 
 	if (!json_object_is_type(anime_array, json_type_array)) {
 		fprintf(stderr, "Json object is not an array\n");
-		free(anime_array);
+		json_object_put(anime_array);
+		return NULL;
+	}
+
+	return anime_array;
+}
+
+/**
+ * Load anime array from file, detecting its storage format
+ * Readability is checked by opening the file, a missing file or folder results in an empty anime array
+ * @param dir_fd folder to resolve filepath against, AT_FDCWD or -1 if the folder does not exist
+ * @param filepath file to load anime array from
+ * @param format where to store the storage format the file is in, used when saving the anime array back
+ * @return pointer to json object representing anime array, or NULL on error
+ */
+struct json_object * load_saved_anime(int dir_fd, const char * filepath, struct storage_format * format) {
+	PROBE1(load__start, filepath);
+	gzFile file = dir_fd == -1 ? NULL : storage_open_read(dir_fd, filepath);
+	if (file == NULL) {
+		if (dir_fd == -1 || errno == ENOENT) { // file does not exist
+			format->encoding = STORAGE_JSON;
+			format->compressed = 0;
+			PROBE2(load__done, 0, 0);
+			return json_object_new_array_ext(1);
+		}
+		fprintf(stderr, errno == EACCES ? "Anime file is not readable\n" : "Failed to open the file for reading\n");
+		PROBE2(load__done, -1, 0);
 		return NULL;
 	}
 
+	struct json_object * anime_array;
+	anime_array = read_anime_file(file, format);
+	// gzoffset() costs an lseek, so the arguments are only taken when traced
+	PROBE2(load__done, anime_array == NULL ? -1 : PROBE_ENABLED(load__done) ? (int) json_object_array_length(anime_array) : 0,
+		   PROBE_ENABLED(load__done) ? gzoffset(file) : 0);
+	gzclose(file);
+
 	return anime_array;
 }
 
 /**
- * Save anime array as a json file
+ * Save anime array to a file
+ * @param dir_fd folder to resolve filepath against, or AT_FDCWD
  * @param filepath file to save anime array to
  * @param anime_array anime array to save
+ * @param format storage format to use
  * @return 0 on success, otherwise -1 on error
  */
-int save_anime(char* filepath, struct json_object * anime_array) {
-	const char * json_str;
-	size_t json_str_len;
-	FILE * file = fopen(filepath, "w");
+int save_anime(int dir_fd, const char * filepath, struct json_object * anime_array, struct storage_format format) {
+	PROBE3(save__start, filepath, PROBE_ENABLED(save__start) ? json_object_array_length(anime_array) : 0, format.encoding);
+	gzFile file = storage_open_write(dir_fd, filepath, format);
 	if (file == NULL) {
-		fprintf(stderr, "Failed to open the file for writing\n");
+		fprintf(stderr, errno == EACCES ? "Anime file is not writable\n" : "Failed to open the file for writing\n");
+		PROBE1(save__done, -1);
 		return -1;
 	}
 
-	json_str = json_object_to_json_string_ext(anime_array, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_SPACED);
-	json_str_len = strlen(json_str);
+	if (storage_write(file, anime_array, format) != 0) {
+		gzclose(file);
+		PROBE1(save__done, -1);
+		return -1;
+	}
 
-	if (fwrite(json_str, sizeof(char), json_str_len, file) != json_str_len) {
+	if (gzclose(file) != Z_OK) {
 		fprintf(stderr, "Failed to write anime information into the file\n");
-		fclose(file);
+		PROBE1(save__done, -1);
+		return -1;
+	}
+	PROBE1(save__done, 0);
+	return 0;
+}
+
+/**
+ * Replace the contents of anime array with anime read from a file
+ * @param filepath file to import anime array from, in any supported storage format
+ * @param anime_array anime array to replace the contents of
+ * @param format where to store the storage format of the imported file, used when saving the anime array
+ * @return 0 on success, otherwise -1 on error
+ */
+int import_anime(char * filepath, struct json_object * anime_array, struct storage_format * format) {
+	size_t i, n_anime;
+	struct storage_format imported_format;
+	struct json_object * imported;
+
+	gzFile file = storage_open_read(AT_FDCWD, filepath);
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open the file for reading\n");
+		return -1;
+	}
+	imported = read_anime_file(file, &imported_format);
+	gzclose(file);
+	if (imported == NULL) return -1;
+
+	json_object_array_del_idx(anime_array, 0, json_object_array_length(anime_array));
+	n_anime = json_object_array_length(imported);
+	for (i=0; i<n_anime; i++) {
+		json_object_array_add(anime_array, json_object_get(json_object_array_get_idx(imported, i)));
+	}
+	json_object_put(imported);
+
+	*format = imported_format;
+	return 0;
+}
+
+/**
+ * Get the id identifying a folder to the folders it is synchronized with, creating it on first use
+ * @param dir_fd folder to get the id of
+ * @param id where to store the id, must fit ANIME_UID_LENGTH characters and a '\0'
+ * @return 0 on success, otherwise -1 on error
+ */
+int get_sync_id(int dir_fd, char * id) {
+	ssize_t length;
+	int fd = openat(dir_fd, SYNC_ID_FILENAME, O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		length = read(fd, id, ANIME_UID_LENGTH);
+		close(fd);
+		if (length != ANIME_UID_LENGTH) {
+			fprintf(stderr, "Malformed " SYNC_ID_FILENAME " file\n");
+			return -1;
+		}
+		id[ANIME_UID_LENGTH] = '\0';
+		return 0;
+	}
+	if (errno != ENOENT || make_anime_uid(id) != 0) {
+		fprintf(stderr, "Failed to read " SYNC_ID_FILENAME " file\n");
+		return -1;
+	}
+
+	fd = openat(dir_fd, SYNC_ID_FILENAME, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create " SYNC_ID_FILENAME " file\n");
+		return -1;
+	}
+	id[ANIME_UID_LENGTH] = '\n';
+	length = write(fd, id, ANIME_UID_LENGTH + 1);
+	id[ANIME_UID_LENGTH] = '\0';
+	if (close(fd) != 0 || length != ANIME_UID_LENGTH + 1) {
+		fprintf(stderr, "Failed to write " SYNC_ID_FILENAME " file\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Synchronize anime array with the app subfolder of another machine, e.g. a mounted or shared one
+ * Both sides are three-way merged against the state of their last synchronization, kept in both folders,
+ * and only sides that changed are written back. The local anime array is saved here, before the new base.
+ * @param folder local folder used to save anime array
+ * @param other_path app subfolder of the other machine
+ * @param anime_array local anime array, replaced with the merged one
+ * @param format storage format of the local anime array
+ * @return 0 on success, otherwise -1 on error
+ */
+int sync_anime(struct save_folder * folder, const char * other_path, struct json_object * anime_array, struct storage_format format) {
+	int return_code = -1;
+	size_t i, n_anime, local_assigned = 0, other_assigned = 0;
+	char local_id[ANIME_UID_LENGTH + 1], other_id[ANIME_UID_LENGTH + 1];
+	char local_base_filename[sizeof(SYNC_BASE_FILENAME) + ANIME_UID_LENGTH];
+	char other_base_filename[sizeof(SYNC_BASE_FILENAME) + ANIME_UID_LENGTH];
+	struct storage_format other_format, base_format;
+	struct storage_format base_save_format = {STORAGE_JSON, 0};
+	struct json_object * other_array = NULL;
+	struct json_object * base_array = NULL;
+	struct json_object * merged_array = NULL;
+	struct sync_changes local_changes, other_changes;
+
+	if (create_save_folder(folder) != 0) return -1;
+	int other_fd = open(other_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (other_fd == -1) {
+		fprintf(stderr, "Failed to open the folder to synchronize with\n");
 		return -1;
 	}
+	if (get_sync_id(folder->fd, local_id) != 0 || get_sync_id(other_fd, other_id) != 0) {
+		close(other_fd);
+		return -1;
+	}
+	if (strcmp(local_id, other_id) == 0) {
+		fprintf(stderr, "Can't synchronize a folder with itself\n");
+		close(other_fd);
+		return -1;
+	}
+	// each folder keeps the base it shares with the other, named after the other's id
+	snprintf(local_base_filename, sizeof(local_base_filename), SYNC_BASE_FILENAME, other_id);
+	snprintf(other_base_filename, sizeof(other_base_filename), SYNC_BASE_FILENAME, local_id);
+
+	other_array = load_saved_anime(other_fd, SAVED_ANIME_FILENAME, &other_format);
+	if (other_array != NULL) base_array = load_saved_anime(folder->fd, local_base_filename, &base_format);
+	// anime saved before ids existed get them now, which alone is a reason to save a side
+	if (base_array != NULL && sync_assign_uids(anime_array, other_array, &local_assigned, &other_assigned) == 0) {
+		merged_array = sync_merge(base_array, anime_array, other_array, &local_changes, &other_changes);
+	}
+
+	if (merged_array != NULL
+		&& (other_assigned + other_changes.added + other_changes.updated + other_changes.removed == 0
+			|| save_anime(other_fd, SAVED_ANIME_FILENAME, merged_array, other_format) == 0)
+		&& (local_assigned + local_changes.added + local_changes.updated + local_changes.removed == 0
+			|| save_anime(folder->fd, SAVED_ANIME_FILENAME, merged_array, format) == 0)
+		&& (json_object_equal(base_array, merged_array)
+			|| (save_anime(folder->fd, local_base_filename, merged_array, base_save_format) == 0
+				&& save_anime(other_fd, other_base_filename, merged_array, base_save_format) == 0))) {
+		printf("Pulled %zu added, %zu updated and %zu removed anime\n", local_changes.added, local_changes.updated, local_changes.removed);
+		printf("Pushed %zu added, %zu updated and %zu removed anime\n", other_changes.added, other_changes.updated, other_changes.removed);
+
+		json_object_array_del_idx(anime_array, 0, json_object_array_length(anime_array));
+		n_anime = json_object_array_length(merged_array);
+		for (i=0; i<n_anime; i++) {
+			json_object_array_add(anime_array, json_object_get(json_object_array_get_idx(merged_array, i)));
+		}
+		return_code = 0;
+	}
+
+	json_object_put(merged_array);
+	json_object_put(base_array);
+	json_object_put(other_array);
+	close(other_fd);
+	return return_code;
+}
+
+/**
+ * Helper function to parse a list option value as a count
+ * @param value option value
+ * @param count where to store the count
+ * @return 0 on success, otherwise -1 on error
+ */
+int parse_list_count(const char * value, size_t * count) {
+	char * end;
+
+	if (value == NULL || *value < '0' || *value > '9') return -1;
+	*count = strtoul(value, &end, 10);
+	return *end == '\0' ? 0 : -1;
+}
+
+/**
+ * Parse list command options
+ * @param argc number of options
+ * @param argv options array
+ * @param options where to store parsed options
+ * @return 0 on success, otherwise -1 on error
+ */
+int parse_list_options(int argc, char ** argv, struct list_options * options) {
+	static const char * sorts[] = {"none", "name", "next-airing", "remaining", "start"};
+	static const char * filters[] = {"airing", "finished", "ignored", "has-new"};
+	int i;
+	size_t j, length;
+	const char * value;
+	const char * next;
+
+	for (i=0; i<argc; i++) {
+		if (strncmp("--sort=", argv[i], 7) == 0) {
+			value = argv[i] + 7;
+			for (j=0; j<sizeof(sorts)/sizeof(sorts[0]); j++) {
+				if (strcmp(sorts[j], value) == 0) break;
+			}
+			if (j == sizeof(sorts)/sizeof(sorts[0])) {
+				fprintf(stderr, "Unknown sort key '%s'.\n", value);
+				return -1;
+			}
+			options->sort = (enum LIST_SORT) j;
+		} else if (strncmp("--filter=", argv[i], 9) == 0) {
+			for (value = argv[i] + 9; *value != '\0'; value = *next == ',' ? next + 1 : next) {
+				next = strchrnul(value, ',');
+				length = next - value;
+				for (j=0; j<sizeof(filters)/sizeof(filters[0]); j++) {
+					if (strlen(filters[j]) == length && strncmp(filters[j], value, length) == 0) break;
+				}
+				if (j == sizeof(filters)/sizeof(filters[0])) {
+					fprintf(stderr, "Unknown filter '%.*s'.\n", (int) length, value);
+					return -1;
+				}
+				options->filter |= 1 << j;
+			}
+		} else if (strcmp("--limit", argv[i]) == 0 || strncmp("--limit=", argv[i], 8) == 0) {
+			value = argv[i][7] == '=' ? argv[i] + 8 : (i + 1 < argc ? argv[++i] : NULL);
+			if (parse_list_count(value, &options->limit) != 0) {
+				fprintf(stderr, "Please specify a valid limit.\n");
+				return -1;
+			}
+		} else if (strcmp("--offset", argv[i]) == 0 || strncmp("--offset=", argv[i], 9) == 0) {
+			value = argv[i][8] == '=' ? argv[i] + 9 : (i + 1 < argc ? argv[++i] : NULL);
+			if (parse_list_count(value, &options->offset) != 0) {
+				fprintf(stderr, "Please specify a valid offset.\n");
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "Unknown list option '%s'.\n", argv[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Helper function to parse a stats date as local midnight
+ * @param value date in YYYY-MM-DD format
+ * @param days days to add to the date, added to the calendar date so days lengthened or shortened by DST are whole
+ * @param date where to store the parsed date
+ * @return 0 on success, otherwise -1 on error
+ */
+int parse_stats_date(const char * value, int days, time_t * date) {
+	struct tm datetime;
+	char * end;
+
+	if (value == NULL) return -1;
+	memset(&datetime, 0, sizeof(datetime));
+	end = strptime(value, "%Y-%m-%d", &datetime);
+	if (end == NULL || *end != '\0') return -1;
+	datetime.tm_mday += days;
+	datetime.tm_isdst = -1;
+	*date = mktime(&datetime);
+	return *date == -1 ? -1 : 0;
+}
+
+/**
+ * Parse stats command options
+ * @param argc number of options
+ * @param argv options array
+ * @param range where to store whether a date range was given
+ * @param from where to store the start of the date range
+ * @param to where to store the end of the date range, exclusive
+ * @return 0 on success, otherwise -1 on error
+ */
+int parse_stats_options(int argc, char ** argv, int * range, time_t * from, time_t * to) {
+	int i, to_given = 0;
+
+	*range = 0;
+	*from = 0;
+	for (i=0; i<argc; i++) {
+		if (strcmp("--from", argv[i]) == 0) {
+			if (parse_stats_date(i + 1 < argc ? argv[++i] : NULL, 0, from) != 0) {
+				fprintf(stderr, "Please specify a valid start date.\n");
+				return -1;
+			}
+			*range = 1;
+		} else if (strcmp("--to", argv[i]) == 0) {
+			if (parse_stats_date(i + 1 < argc ? argv[++i] : NULL, 1, to) != 0) { // the end date is inclusive
+				fprintf(stderr, "Please specify a valid end date.\n");
+				return -1;
+			}
+			*range = 1;
+			to_given = 1;
+		} else {
+			fprintf(stderr, "Unknown stats option '%s'.\n", argv[i]);
+			return -1;
+		}
+	}
+	if (!*range) return 0;
 
-	fclose(file);
+	if (!to_given) { // until the end of today
+		time_t now = time(NULL);
+		struct tm * today = localtime(&now);
+		today->tm_hour = today->tm_min = today->tm_sec = 0;
+		today->tm_mday++;
+		today->tm_isdst = -1;
+		*to = mktime(today);
+	}
+	if (*from >= *to) {
+		fprintf(stderr, "The start date must not be after the end date.\n");
+		return -1;
+	}
 	return 0;
 }
 
@@ -171,15 +553,95 @@ int save_anime(char* filepath, struct json_object * anime_array) {
  * Process arguments and take an appropriate action
  * @param argc number of arguments
  * @param argv arguments array
+ * @param folder folder used to save anime array
  * @param anime_array anime array to use in actions
+ * @param format storage format of the anime array, may be changed by actions
  * @return on success, 1 is returned if saving is necessary, 0 if not, otherwise -1 on error
  */
-int process_args_do_action(int argc, char ** argv, struct json_object * anime_array) {
+int process_args_do_action(int argc, char ** argv, struct save_folder * folder, struct json_object * anime_array, struct storage_format * format) {
 	if (argc == 1) {
 		print_new_episodes(anime_array);
 		return 0;
 	}
 
+	if (strcmp("--template", argv[1]) == 0) { // TEMPLATE
+		if (argc < 3) {
+			fprintf(stderr, "Please specify the template to use.\n");
+			return -1;
+		}
+		struct template * tmpl = template_compile(argv[2]);
+		if (tmpl == NULL) return -1;
+		int return_code = print_template(tmpl, anime_array);
+		template_free(tmpl);
+		return return_code;
+	}
+
+	if (strcmp("export", argv[1]) == 0) { // EXPORT
+		if (argc < 3) {
+			fprintf(stderr, "Please specify the file to export anime to.\n");
+			return -1;
+		}
+		struct storage_format export_format = {STORAGE_JSON, 0};
+		if (argc > 3 && parse_storage_format(argv[3], &export_format) != 0) {
+			fprintf(stderr, "Unknown storage format '%s'.\n", argv[3]);
+			return -1;
+		}
+		return save_anime(AT_FDCWD, argv[2], anime_array, export_format);
+	} else if (strcmp("import", argv[1]) == 0) { // IMPORT
+		if (argc < 3) {
+			fprintf(stderr, "Please specify the file to import anime from.\n");
+			return -1;
+		}
+		return import_anime(argv[2], anime_array, format) == 0 ? 1 : -1;
+	} else if (strcmp("sync", argv[1]) == 0) { // SYNC
+		if (argc < 3) {
+			fprintf(stderr, "Please specify the aweek folder to synchronize with.\n");
+			return -1;
+		}
+		return sync_anime(folder, argv[2], anime_array, *format);
+	}
+
+	if ('a' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("add", argv[1]) == 0)) { // ADD
+		if (argc < 3) return add_anime(anime_array, MANUAL, NULL) == 0 ? 1 : -1;
+
+		enum ADD_ANIME_METHOD method;
+		if (detect_export_method(argv[2], &method) != 0) return -1;
+		return add_anime(anime_array, method, argv[2]) == 0 ? 1 : -1;
+	}
+
+	if ('l' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("list", argv[1]) == 0)) { // LIST
+		struct list_options options = {SORT_NONE, 0, 0, 0};
+		if (parse_list_options(argc - 2, argv + 2, &options) != 0) return -1;
+		return list_all(anime_array, &options);
+	}
+
+	if (strcmp("set", argv[1]) == 0) { // SET
+		if (argc < 5 || strcmp("--where", argv[2]) != 0) {
+			fprintf(stderr, "Please specify the anime to update with --where '<query>' followed by field=value assignments.\n");
+			return -1;
+		}
+		struct query * where = query_compile(argv[3]);
+		if (where == NULL) return -1;
+		int updated = set_anime(anime_array, where, argc - 4, argv + 4);
+		query_free(where);
+		return updated < 0 ? -1 : updated > 0;
+	}
+
+	if (strcmp("stats", argv[1]) == 0) { // STATS
+		if (argc > 2 && argv[2][0] != '-') {
+			size_t stats_id = strtoul(argv[2], NULL, 10) - 1;
+			if (stats_id >= json_object_array_length(anime_array)) {
+				fprintf(stderr, "No anime with id %zu.\n", stats_id + 1);
+				return -1;
+			}
+			return print_anime_stats(folder->fd, json_object_array_get_idx(anime_array, stats_id));
+		}
+		int range;
+		time_t from, to;
+		if (parse_stats_options(argc - 2, argv + 2, &range, &from, &to) != 0) return -1;
+		return print_stats(folder->fd, range, from, to);
+	}
+
 	size_t anime_id = 0, episodes = 0;
 	if (argc > 2) {
 		anime_id = strtoul(argv[2], NULL, 10) - 1;
@@ -192,9 +654,7 @@ int process_args_do_action(int argc, char ** argv, struct json_object * anime_ar
 		episodes = strtoul(argv[3], NULL, 10);
 	}
 
-	if ('a' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("add", argv[1]) == 0)) { // ADD
-		return add_anime(anime_array, MANUAL) == 0 ? 1 : -1;
-	} else if ('d' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("delete", argv[1]) == 0)) { // DELETE
+	if ('d' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("delete", argv[1]) == 0)) { // DELETE
 		if (argc < 3) {
 			fprintf(stderr, "Please specify id of the anime to delete.\n");
 			return -1;
@@ -224,8 +684,6 @@ int process_args_do_action(int argc, char ** argv, struct json_object * anime_ar
 			return -1;
 		}
 		return toggle_anime_ignored(json_object_array_get_idx(anime_array, anime_id)) == 0 ? 1 : -1;
-	} else if ('l' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("list", argv[1]) == 0)) { // LIST
-		return list_all(anime_array);
 	} else if ('n' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("new-episodes-count", argv[1]) == 0)) { // NEW EPISODES COUNT
 		return print_new_episodes_count(anime_array);
 	} else if ('v' == argv[1][0] && (strlen(argv[1]) == 1 ||  strcmp("version", argv[1]) == 0)) { // VERSION
@@ -244,24 +702,31 @@ int process_args_do_action(int argc, char ** argv, struct json_object * anime_ar
  * @return 0 on success, otherwise -1 on error
  */
 int main(int argc, char ** argv) {
-	char * filepath = get_save_anime_filepath();
-	if (filepath == NULL) return -1;
+	struct save_folder folder;
+	if (open_save_folder(&folder) != 0) return -1;
 
+	struct storage_format format;
 	struct json_object * anime_array;
-	anime_array = load_saved_anime(filepath);
+	anime_array = load_saved_anime(folder.fd, SAVED_ANIME_FILENAME, &format);
 	if (anime_array == NULL) {
-		free(filepath);
+		close_save_folder(&folder);
 		return -1;
 	}
 
-	int return_code = process_args_do_action(argc, argv, anime_array);
+	PROBE2(dispatch__start, argc, argc > 1 ? argv[1] : "");
+	int return_code = process_args_do_action(argc, argv, &folder, anime_array, &format);
+	PROBE1(dispatch__done, return_code);
 
 	if (return_code == 1) {
-		save_anime(filepath, anime_array);
-		return_code = 0;
+		if (create_save_folder(&folder) == 0 && save_anime(folder.fd, SAVED_ANIME_FILENAME, anime_array, format) == 0) {
+			return_code = history_flush(folder.fd, anime_array) == 0 ? 0 : -1;
+		} else {
+			return_code = -1;
+		}
 	}
+	history_discard();
 
 	json_object_put(anime_array);
-	free(filepath);
+	close_save_folder(&folder);
 	return return_code;
 }
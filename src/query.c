@@ -0,0 +1,593 @@
+#define _GNU_SOURCE
+#include <json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../include/anime_functions.h"
+#include "../include/query.h"
+
+#define QUERY_MAX_EPISODES 9999
+
+enum QUERY_TYPE {
+	QUERY_TYPE_NUMBER,
+	QUERY_TYPE_STRING,
+	QUERY_TYPE_BOOLEAN,
+	QUERY_TYPE_LIST, // delayed episodes, can't be compared
+};
+
+/**
+ * Anime fields usable in queries and assignments
+ */
+static const struct {
+	const char * name;
+	enum QUERY_FIELD field;
+	enum QUERY_TYPE type;
+	int settable;
+} query_fields[] = {
+	{"name", QUERY_FIELD_NAME, QUERY_TYPE_STRING, 1},
+	{"episodes", QUERY_FIELD_EPISODES, QUERY_TYPE_NUMBER, 1},
+	{"episodes_downloaded", QUERY_FIELD_DOWNLOADED, QUERY_TYPE_NUMBER, 1},
+	{"start_date", QUERY_FIELD_START_DATE, QUERY_TYPE_NUMBER, 1},
+	{"delayed_episodes", QUERY_FIELD_DELAYED, QUERY_TYPE_LIST, 1},
+	{"ignored", QUERY_FIELD_IGNORED, QUERY_TYPE_BOOLEAN, 1},
+	{"aired", QUERY_FIELD_AIRED, QUERY_TYPE_NUMBER, 0},
+	{"new", QUERY_FIELD_NEW, QUERY_TYPE_NUMBER, 0},
+};
+
+/**
+ * Field assignment parsed from field=value
+ */
+struct query_assignment {
+	enum QUERY_FIELD field;
+	struct json_object * value;
+};
+
+/**
+ * Helper function to look up a field by its name
+ * @param name field name, not null terminated
+ * @param name_len length of the field name
+ * @return index of the field in query_fields, or -1 if no such field exists
+ */
+int query_lookup_field(const char * name, size_t name_len) {
+	size_t i;
+
+	for (i=0; i<sizeof(query_fields)/sizeof(query_fields[0]); i++) {
+		if (strlen(query_fields[i].name) == name_len && memcmp(query_fields[i].name, name, name_len) == 0) return (int) i;
+	}
+	return -1;
+}
+
+/**
+ * Helper function to get the precedence of an operator, higher binds tighter
+ * @param op operator
+ * @return precedence, 0 for an opening parenthesis
+ */
+int query_precedence(enum QUERY_OP op) {
+	switch (op) {
+		case QUERY_OR:
+			return 1;
+		case QUERY_AND:
+			return 2;
+		case QUERY_NOT:
+			return 4;
+		case QUERY_OPEN:
+			return 0;
+		default: // comparisons
+			return 3;
+	}
+}
+
+/**
+ * Helper function to check operand types of a compiled query and size its evaluation stack
+ * @param query compiled query
+ * @return maximum stack depth, or 0 if the query is not a well typed boolean expression
+ */
+size_t query_check_types(struct query * query) {
+	size_t i, depth = 0, max_depth = 0;
+	enum QUERY_TYPE * types;
+	enum QUERY_TYPE left, right;
+	const struct query_op * op;
+
+	types = malloc((query->n_ops + 1) * sizeof(enum QUERY_TYPE));
+	if (types == NULL) return 0;
+
+	for (i=0; i<query->n_ops; i++) {
+		op = &query->ops[i];
+		switch (op->op) {
+			case QUERY_FIELD:
+				types[depth++] = query_fields[op->field].type;
+				break;
+			case QUERY_NUMBER:
+				types[depth++] = QUERY_TYPE_NUMBER;
+				break;
+			case QUERY_STRING:
+				types[depth++] = QUERY_TYPE_STRING;
+				break;
+			case QUERY_BOOLEAN:
+				types[depth++] = QUERY_TYPE_BOOLEAN;
+				break;
+			case QUERY_NOT:
+				if (types[depth-1] != QUERY_TYPE_BOOLEAN) {
+					fprintf(stderr, "'!' needs a boolean operand in query\n");
+					free(types);
+					return 0;
+				}
+				break;
+			default: // binary operators
+				left = types[depth-2];
+				right = types[depth-1];
+				depth--;
+				if (left != right || left == QUERY_TYPE_LIST
+					|| ((op->op == QUERY_AND || op->op == QUERY_OR) && left != QUERY_TYPE_BOOLEAN)
+					|| (op->op >= QUERY_LT && left != QUERY_TYPE_NUMBER)) {
+					fprintf(stderr, "Mismatched operand types in query\n");
+					free(types);
+					return 0;
+				}
+				types[depth-1] = QUERY_TYPE_BOOLEAN;
+				break;
+		}
+		if (depth > max_depth) max_depth = depth;
+	}
+
+	if (types[0] != QUERY_TYPE_BOOLEAN) {
+		fprintf(stderr, "Query is not a condition\n");
+		max_depth = 0;
+	}
+	free(types);
+	return max_depth;
+}
+
+/**
+ * Compile a query over anime fields into a postfix opcode list
+ * Fields are compared with == != < <= > >= and combined with ! && || and parentheses,
+ * e.g. `episodes_downloaded == episodes && !ignored` or `name == "Frieren"`
+ * @param source query to compile
+ * @return compiled query, or NULL on error, must be freed with query_free()
+ */
+struct query * query_compile(const char * source) {
+	size_t i, source_len, n_pending = 0, token_len;
+	int expect_operand = 1, field;
+	char * end;
+	enum QUERY_OP op;
+	enum QUERY_OP * pending; // operators waiting for their right operand
+	struct query * query;
+	struct query_op * emitted;
+
+	// every token is at least one character long
+	source_len = strlen(source);
+	query = malloc(sizeof(struct query) + (source_len + 1) * sizeof(struct query_op));
+	if (query == NULL) return NULL;
+	query->n_ops = 0;
+	query->stack = NULL;
+	query->source = strdup(source);
+	pending = malloc((source_len + 1) * sizeof(enum QUERY_OP));
+	if (query->source == NULL || pending == NULL) {
+		free(pending);
+		query_free(query);
+		return NULL;
+	}
+
+	i = 0;
+	while (i < source_len) {
+		if (source[i] == ' ' || source[i] == '\t') {
+			i++;
+			continue;
+		}
+
+		if (expect_operand) {
+			emitted = &query->ops[query->n_ops];
+			if (source[i] == '(' || source[i] == '!') {
+				pending[n_pending++] = source[i] == '(' ? QUERY_OPEN : QUERY_NOT;
+				i++;
+				continue;
+			} else if (source[i] == '"' || source[i] == '\'') {
+				end = strchr(source + i + 1, source[i]);
+				if (end == NULL) {
+					fprintf(stderr, "Unterminated string in query at position %zu\n", i+1);
+					break;
+				}
+				emitted->op = QUERY_STRING;
+				emitted->offset = i + 1;
+				emitted->length = end - (source + i + 1);
+				i += emitted->length + 2;
+			} else if ((source[i] >= '0' && source[i] <= '9') || source[i] == '-') {
+				emitted->op = QUERY_NUMBER;
+				emitted->number = strtoll(source + i, &end, 10);
+				if (end == source + i) {
+					fprintf(stderr, "Invalid number in query at position %zu\n", i+1);
+					break;
+				}
+				i = end - source;
+			} else {
+				for (token_len=0; (source[i+token_len] >= 'a' && source[i+token_len] <= 'z') || source[i+token_len] == '_'; token_len++);
+				if (token_len == 4 && memcmp(source + i, "true", 4) == 0) {
+					emitted->op = QUERY_BOOLEAN;
+					emitted->number = 1;
+				} else if (token_len == 5 && memcmp(source + i, "false", 5) == 0) {
+					emitted->op = QUERY_BOOLEAN;
+					emitted->number = 0;
+				} else if (token_len > 0 && (field = query_lookup_field(source + i, token_len)) >= 0) {
+					emitted->op = QUERY_FIELD;
+					emitted->field = query_fields[field].field;
+				} else {
+					fprintf(stderr, "Unknown field in query at position %zu\n", i+1);
+					break;
+				}
+				i += token_len;
+			}
+			query->n_ops++;
+			expect_operand = 0;
+			continue;
+		}
+
+		if (source[i] == ')') {
+			while (n_pending > 0 && pending[n_pending-1] != QUERY_OPEN) query->ops[query->n_ops++].op = pending[--n_pending];
+			if (n_pending == 0) {
+				fprintf(stderr, "Unmatched ')' in query at position %zu\n", i+1);
+				break;
+			}
+			n_pending--;
+			i++;
+			continue;
+		}
+
+		token_len = 2;
+		if (strncmp(source + i, "&&", 2) == 0) {
+			op = QUERY_AND;
+		} else if (strncmp(source + i, "||", 2) == 0) {
+			op = QUERY_OR;
+		} else if (strncmp(source + i, "==", 2) == 0) {
+			op = QUERY_EQ;
+		} else if (strncmp(source + i, "!=", 2) == 0) {
+			op = QUERY_NE;
+		} else if (strncmp(source + i, "<=", 2) == 0) {
+			op = QUERY_LE;
+		} else if (strncmp(source + i, ">=", 2) == 0) {
+			op = QUERY_GE;
+		} else if (source[i] == '<' || source[i] == '>') {
+			op = source[i] == '<' ? QUERY_LT : QUERY_GT;
+			token_len = 1;
+		} else {
+			fprintf(stderr, "Expected an operator in query at position %zu\n", i+1);
+			break;
+		}
+		while (n_pending > 0 && query_precedence(pending[n_pending-1]) >= query_precedence(op)) {
+			query->ops[query->n_ops++].op = pending[--n_pending];
+		}
+		pending[n_pending++] = op;
+		i += token_len;
+		expect_operand = 1;
+	}
+
+	if (i >= source_len && expect_operand) fprintf(stderr, "Unexpected end of query\n");
+	while (i >= source_len && !expect_operand && n_pending > 0) {
+		if (pending[n_pending-1] == QUERY_OPEN) {
+			fprintf(stderr, "Unmatched '(' in query\n");
+			break;
+		}
+		query->ops[query->n_ops++].op = pending[--n_pending];
+	}
+	if (i < source_len || expect_operand || n_pending > 0) { // stopped on an error
+		free(pending);
+		query_free(query);
+		return NULL;
+	}
+	free(pending);
+
+	i = query_check_types(query);
+	if (i == 0 || (query->stack = malloc(i * sizeof(struct query_value))) == NULL) {
+		query_free(query);
+		return NULL;
+	}
+	return query;
+}
+
+/**
+ * Free a compiled query
+ * @param query query to free, may be NULL
+ */
+void query_free(struct query * query) {
+	if (query == NULL) return;
+	free(query->stack);
+	free(query->source);
+	free(query);
+}
+
+/**
+ * Helper function to get the value of an anime field
+ * @param anime anime json object
+ * @param field field to get
+ * @param now current time, used for aired and new episodes
+ * @param value where to store the value
+ * @return 0 on success, otherwise -1 on error
+ */
+int query_field_value(struct json_object * anime, enum QUERY_FIELD field, time_t now, struct query_value * value) {
+	int aired;
+	struct json_object * field_obj;
+	struct json_object * downloaded_obj;
+
+	value->string = NULL;
+	if (field == QUERY_FIELD_AIRED || field == QUERY_FIELD_NEW) {
+		aired = get_aired_episodes_count(anime, now);
+		if (aired < 0) return -1;
+		value->number = aired;
+		if (field == QUERY_FIELD_AIRED) return 0;
+
+		// new episodes, counted the same way as get_new_episodes_count()
+		if (!json_object_object_get_ex(anime, "ignored", &field_obj)
+			|| !json_object_object_get_ex(anime, "episodes_downloaded", &downloaded_obj)) {
+			fprintf(stderr, "Malformed json\n");
+			return -1;
+		}
+		value->number -= json_object_get_int64(downloaded_obj);
+		if (json_object_get_boolean(field_obj) || value->number < 0) value->number = 0;
+		return 0;
+	}
+
+	if (!json_object_object_get_ex(anime, query_fields[field].name, &field_obj)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	if (query_fields[field].type == QUERY_TYPE_STRING) {
+		value->string = json_object_get_string(field_obj);
+		value->length = json_object_get_string_len(field_obj);
+	} else if (query_fields[field].type == QUERY_TYPE_BOOLEAN) {
+		value->number = json_object_get_boolean(field_obj);
+	} else {
+		value->number = json_object_get_int64(field_obj);
+	}
+	return 0;
+}
+
+/**
+ * Check whether an anime matches a compiled query
+ * @param query compiled query
+ * @param anime anime json object
+ * @param now current time, used for aired and new episodes
+ * @return 1 if the anime matches, 0 if not, or -1 on error
+ */
+int query_match(const struct query * query, struct json_object * anime, time_t now) {
+	size_t i, top = 0;
+	int result;
+	struct query_value * stack = query->stack;
+	const struct query_op * op;
+
+	for (i=0; i<query->n_ops; i++) {
+		op = &query->ops[i];
+		switch (op->op) {
+			case QUERY_FIELD:
+				if (query_field_value(anime, op->field, now, &stack[top]) != 0) return -1;
+				top++;
+				continue;
+			case QUERY_NUMBER:
+			case QUERY_BOOLEAN:
+				stack[top].string = NULL;
+				stack[top++].number = op->number;
+				continue;
+			case QUERY_STRING:
+				stack[top].string = query->source + op->offset;
+				stack[top++].length = op->length;
+				continue;
+			case QUERY_NOT:
+				stack[top-1].number = !stack[top-1].number;
+				continue;
+			default:
+				break;
+		}
+
+		// binary operators, operand types were checked when compiling
+		top--;
+		if (stack[top].string != NULL) {
+			result = stack[top-1].length == stack[top].length && memcmp(stack[top-1].string, stack[top].string, stack[top].length) == 0;
+			if (op->op == QUERY_NE) result = !result;
+		} else {
+			switch (op->op) {
+				case QUERY_AND: result = stack[top-1].number && stack[top].number; break;
+				case QUERY_OR: result = stack[top-1].number || stack[top].number; break;
+				case QUERY_EQ: result = stack[top-1].number == stack[top].number; break;
+				case QUERY_NE: result = stack[top-1].number != stack[top].number; break;
+				case QUERY_LT: result = stack[top-1].number < stack[top].number; break;
+				case QUERY_LE: result = stack[top-1].number <= stack[top].number; break;
+				case QUERY_GT: result = stack[top-1].number > stack[top].number; break;
+				default: result = stack[top-1].number >= stack[top].number; break;
+			}
+		}
+		stack[top-1].string = NULL;
+		stack[top-1].number = result;
+	}
+
+	return stack[0].number != 0;
+}
+
+/**
+ * Helper function to parse an unsigned number that makes up a whole string
+ * @param text text to parse
+ * @param max largest allowed value
+ * @param number where to store the number
+ * @return 0 on success, otherwise -1 on error
+ */
+int query_parse_number(const char * text, uint64_t max, uint64_t * number) {
+	char * end;
+
+	if (*text < '0' || *text > '9') return -1;
+	*number = strtoull(text, &end, 10);
+	return *end == '\0' && *number <= max ? 0 : -1;
+}
+
+/**
+ * Helper function to parse and validate a field=value assignment
+ * @param text assignment to parse
+ * @param assignment where to store the parsed assignment, its value must be freed with json_object_put()
+ * @return 0 on success, otherwise -1 on error
+ */
+int query_parse_assignment(const char * text, struct query_assignment * assignment) {
+	int field;
+	uint64_t number;
+	char episode[8];
+	const char * value = strchr(text, '=');
+	const char * next;
+
+	if (value == NULL || (field = query_lookup_field(text, value - text)) < 0 || !query_fields[field].settable) {
+		fprintf(stderr, "Invalid assignment '%s', expected one of name, episodes, episodes_downloaded, start_date, delayed_episodes or ignored set with field=value.\n", text);
+		return -1;
+	}
+	assignment->field = query_fields[field].field;
+	value++;
+
+	switch (assignment->field) {
+		case QUERY_FIELD_NAME:
+			assignment->value = *value == '\0' ? NULL : json_object_new_string(value);
+			break;
+		case QUERY_FIELD_EPISODES:
+			assignment->value = query_parse_number(value, QUERY_MAX_EPISODES, &number) == 0 && number > 0 ? json_object_new_uint64(number) : NULL;
+			break;
+		case QUERY_FIELD_DOWNLOADED:
+			assignment->value = query_parse_number(value, QUERY_MAX_EPISODES, &number) == 0 ? json_object_new_uint64(number) : NULL;
+			break;
+		case QUERY_FIELD_START_DATE:
+			assignment->value = query_parse_number(value, INT64_MAX, &number) == 0 ? json_object_new_int64((int64_t) number) : NULL;
+			break;
+		case QUERY_FIELD_IGNORED:
+			assignment->value = strcmp(value, "true") == 0 || strcmp(value, "false") == 0 ? json_object_new_boolean(value[0] == 't') : NULL;
+			break;
+		default: // delayed episodes, comma separated
+			assignment->value = json_object_new_array();
+			for (; assignment->value != NULL && *value != '\0'; value = *next == ',' ? next + 1 : next) {
+				next = strchrnul(value, ',');
+				if ((size_t) (next - value) >= sizeof(episode)) {
+					json_object_put(assignment->value);
+					assignment->value = NULL;
+					break;
+				}
+				memcpy(episode, value, next - value);
+				episode[next - value] = '\0';
+				if (query_parse_number(episode, QUERY_MAX_EPISODES, &number) != 0 || number == 0) {
+					json_object_put(assignment->value);
+					assignment->value = NULL;
+					break;
+				}
+				json_object_array_add(assignment->value, json_object_new_uint64(number));
+			}
+			break;
+	}
+
+	if (assignment->value == NULL) {
+		fprintf(stderr, "Invalid value in assignment '%s'.\n", text);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to get the value an anime field will have after assignments
+ * @param anime anime json object
+ * @param assignments parsed assignments
+ * @param n_assignments number of assignments
+ * @param field field to get
+ * @return field value
+ */
+uint64_t query_assigned_number(struct json_object * anime, const struct query_assignment * assignments, size_t n_assignments, enum QUERY_FIELD field) {
+	size_t i;
+	struct json_object * field_obj = NULL;
+
+	for (i=0; i<n_assignments; i++) {
+		if (assignments[i].field == field) return json_object_get_uint64(assignments[i].value);
+	}
+	json_object_object_get_ex(anime, query_fields[field].name, &field_obj);
+	return json_object_get_uint64(field_obj);
+}
+
+/**
+ * Helper function to assign fields to an anime, downloaded episodes count is set last through update_anime()
+ * @param anime anime to change
+ * @param assignments parsed assignments
+ * @param n_assignments number of assignments
+ * @return 0 on success, otherwise -1 on error
+ */
+int query_apply(struct json_object * anime, const struct query_assignment * assignments, size_t n_assignments) {
+	size_t i;
+	struct json_object * value;
+
+	for (i=0; i<n_assignments; i++) {
+		if (assignments[i].field == QUERY_FIELD_DOWNLOADED) continue;
+		value = NULL;
+		if (json_object_deep_copy(assignments[i].value, &value, NULL) != 0
+			|| json_object_object_add(anime, query_fields[assignments[i].field].name, value) != 0
+			|| touch_anime_field(anime, query_fields[assignments[i].field].name) != 0) {
+			return -1;
+		}
+	}
+	for (i=0; i<n_assignments; i++) {
+		if (assignments[i].field == QUERY_FIELD_DOWNLOADED && update_anime(anime, json_object_get_uint64(assignments[i].value)) != 0) return -1;
+	}
+	return 0;
+}
+
+/**
+ * Set fields of every anime matching a query
+ * Assignments are parsed and every match is validated before anything is changed,
+ * so on error the anime array is left as it was
+ * @param anime_array anime array to update
+ * @param where compiled query selecting anime to update
+ * @param n_assignments number of assignments
+ * @param assignments field=value assignments
+ * @return number of updated anime, otherwise -1 on error
+ */
+int set_anime(struct json_object * anime_array, const struct query * where, int n_assignments, char ** assignments) {
+	int return_code = -1, matched;
+	size_t i, j, n_anime, n_parsed = 0, n_matches = 0;
+	size_t * matches;
+	struct query_assignment * parsed;
+	struct json_object * anime;
+	time_t now = time(NULL);
+
+	n_anime = json_object_array_length(anime_array);
+	parsed = malloc(n_assignments * sizeof(struct query_assignment));
+	matches = malloc((n_anime + 1) * sizeof(size_t));
+	if (parsed == NULL || matches == NULL) {
+		free(parsed);
+		free(matches);
+		return -1;
+	}
+
+	for (; n_parsed < (size_t) n_assignments; n_parsed++) {
+		if (query_parse_assignment(assignments[n_parsed], &parsed[n_parsed]) != 0) break;
+		for (j=0; j<n_parsed && parsed[j].field != parsed[n_parsed].field; j++);
+		if (j < n_parsed) {
+			fprintf(stderr, "Field in assignment '%s' is already set.\n", assignments[n_parsed]);
+			json_object_put(parsed[n_parsed].value);
+			break;
+		}
+	}
+
+	// one pass to find and validate matches, nothing is changed until all of them are valid
+	for (i=0; n_parsed == (size_t) n_assignments && i<n_anime; i++) {
+		anime = json_object_array_get_idx(anime_array, i);
+		matched = query_match(where, anime, now);
+		if (matched < 0) break;
+		if (!matched) continue;
+		if (query_assigned_number(anime, parsed, n_parsed, QUERY_FIELD_DOWNLOADED) > query_assigned_number(anime, parsed, n_parsed, QUERY_FIELD_EPISODES)) {
+			fprintf(stderr, "Anime with id %zu would have more downloaded episodes than episodes, nothing was changed.\n", i+1);
+			break;
+		}
+		matches[n_matches++] = i;
+	}
+
+	if (n_parsed == (size_t) n_assignments && i == n_anime) {
+		for (i=0; i<n_matches; i++) {
+			if (query_apply(json_object_array_get_idx(anime_array, matches[i]), parsed, n_parsed) != 0) break;
+		}
+		if (i == n_matches) {
+			printf("Updated %zu anime\n", n_matches);
+			return_code = (int) n_matches;
+		}
+	}
+
+	for (j=0; j<n_parsed; j++) json_object_put(parsed[j].value);
+	free(parsed);
+	free(matches);
+	return return_code;
+}
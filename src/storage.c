@@ -0,0 +1,641 @@
+#include <json.h>
+#include <zlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/storage.h"
+#include "../include/probes.h"
+
+#define STORAGE_BUFFER_SIZE 65536
+#define CBOR_MAX_DEPTH 64
+#define JSON_INDENT_WIDTH 2
+
+// self-describe CBOR tag 55799, written at the start of every CBOR file
+static const unsigned char cbor_magic[] = {0xd9, 0xd9, 0xf7};
+
+enum CBOR_MAJOR {
+	CBOR_UINT = 0,
+	CBOR_NEGINT = 1,
+	CBOR_BYTES = 2,
+	CBOR_TEXT = 3,
+	CBOR_ARRAY = 4,
+	CBOR_MAP = 5,
+	CBOR_TAG = 6,
+	CBOR_SIMPLE = 7,
+};
+
+/**
+ * Buffered input shared by all storage format decoders
+ */
+struct storage_reader {
+	gzFile file;
+	size_t at, length;
+	unsigned char buffer[STORAGE_BUFFER_SIZE];
+};
+
+/**
+ * Parse storage format name
+ * @param name format name: "json" or "cbor", followed by ".gz" for a compressed file
+ * @param format where to store the parsed format
+ * @return 0 on success, otherwise -1 if the name is unknown
+ */
+int parse_storage_format(const char * name, struct storage_format * format) {
+	size_t name_len = strlen(name);
+
+	format->compressed = name_len > 3 && strcmp(name + name_len - 3, ".gz") == 0;
+	if (format->compressed) name_len -= 3;
+
+	if (name_len == 4 && strncmp(name, "json", name_len) == 0) {
+		format->encoding = STORAGE_JSON;
+	} else if (name_len == 4 && strncmp(name, "cbor", name_len) == 0) {
+		format->encoding = STORAGE_CBOR;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Open a file to read the anime array from
+ * Compressed files are decompressed on the fly, plain files are read as is
+ * @param dir_fd folder to resolve filepath against, or AT_FDCWD
+ * @param filepath file to open
+ * @return opened file, or NULL on error with errno set
+ */
+gzFile storage_open_read(int dir_fd, const char * filepath) {
+	int fd = openat(dir_fd, filepath, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return NULL;
+
+	gzFile file = gzdopen(fd, "rb");
+	if (file == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	gzbuffer(file, STORAGE_BUFFER_SIZE);
+	return file;
+}
+
+/**
+ * Open a file to write the anime array to
+ * @param dir_fd folder to resolve filepath against, or AT_FDCWD
+ * @param filepath file to open, created or truncated
+ * @param format storage format the file will be written in
+ * @return opened file, or NULL on error with errno set
+ */
+gzFile storage_open_write(int dir_fd, const char * filepath, struct storage_format format) {
+	int fd = openat(dir_fd, filepath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) return NULL;
+
+	// "T" writes the file without compression
+	gzFile file = gzdopen(fd, format.compressed ? "wb6" : "wbT");
+	if (file == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	gzbuffer(file, STORAGE_BUFFER_SIZE);
+	return file;
+}
+
+/**
+ * Helper function to refill the reader buffer once it has been consumed
+ * @param reader reader to refill
+ * @return 0 if there is data available, otherwise -1 on end of file or error
+ */
+int storage_reader_fill(struct storage_reader * reader) {
+	if (reader->at < reader->length) return 0;
+
+	reader->at = 0;
+	int read = gzread(reader->file, reader->buffer, STORAGE_BUFFER_SIZE);
+	if (read <= 0) {
+		if (read < 0) fprintf(stderr, "Failed to read file: %s\n", gzerror(reader->file, &read));
+		reader->length = 0;
+		return -1;
+	}
+	reader->length = (size_t) read;
+	return 0;
+}
+
+/**
+ * Helper function to read an exact number of bytes from the reader
+ * @param reader reader to read from
+ * @param destination where to store the bytes
+ * @param count number of bytes to read
+ * @return 0 on success, otherwise -1 on error
+ */
+int storage_reader_read(struct storage_reader * reader, void * destination, size_t count) {
+	size_t chunk;
+	unsigned char * out = destination;
+
+	while (count > 0) {
+		if (storage_reader_fill(reader) != 0) {
+			fprintf(stderr, "Unexpected end of file\n");
+			return -1;
+		}
+		chunk = reader->length - reader->at;
+		if (chunk > count) chunk = count;
+		memcpy(out, reader->buffer + reader->at, chunk);
+		reader->at += chunk;
+		out += chunk;
+		count -= chunk;
+	}
+	return 0;
+}
+
+/**
+ * Helper function to parse json from the reader, feeding the tokener one buffer at a time
+ * @param reader reader to parse from
+ * @return parsed json object, or NULL on error
+ */
+struct json_object * json_read(struct storage_reader * reader) {
+	struct json_object * object = NULL;
+	enum json_tokener_error error;
+	json_tokener * tokener = json_tokener_new();
+	if (tokener == NULL) return NULL;
+
+	while (storage_reader_fill(reader) == 0) {
+		object = json_tokener_parse_ex(tokener, (const char *) reader->buffer + reader->at,
+									   (int) (reader->length - reader->at));
+		reader->at = reader->length;
+		error = json_tokener_get_error(tokener);
+		if (error == json_tokener_success) break;
+		if (error != json_tokener_continue) {
+			fprintf(stderr, "Failed to parse json: %s\n", json_tokener_error_desc(error));
+			break;
+		}
+	}
+
+	json_tokener_free(tokener);
+	return object;
+}
+
+/**
+ * Helper function to read the head of a CBOR data item
+ * @param reader reader to read from
+ * @param major where to store the major type
+ * @param info where to store the additional information bits
+ * @param argument where to store the argument (length, value or simple value)
+ * @return 0 on success, otherwise -1 on error
+ */
+int cbor_read_head(struct storage_reader * reader, int * major, int * info, uint64_t * argument) {
+	unsigned char head[9];
+	size_t i, length;
+
+	if (storage_reader_read(reader, head, 1) != 0) return -1;
+	*major = head[0] >> 5;
+	*info = head[0] & 0x1f;
+
+	if (*info < 24) {
+		*argument = (uint64_t) *info;
+		return 0;
+	}
+	if (*info > 27) {
+		fprintf(stderr, "Unsupported CBOR encoding\n");
+		return -1;
+	}
+
+	length = (size_t) 1 << (*info - 24);
+	if (storage_reader_read(reader, head + 1, length) != 0) return -1;
+	*argument = 0;
+	for (i=1; i<=length; i++) *argument = (*argument << 8) | head[i];
+	return 0;
+}
+
+/**
+ * Helper function to read a CBOR text string argument into a null terminated buffer
+ * @param reader reader to read from
+ * @param length string length in bytes
+ * @return newly allocated string, or NULL on error
+ */
+char * cbor_read_text(struct storage_reader * reader, uint64_t length) {
+	char * text;
+
+	if (length >= INT_MAX) {
+		fprintf(stderr, "CBOR string is too long\n");
+		return NULL;
+	}
+	text = malloc(length + 1);
+	if (text == NULL) return NULL;
+	if (storage_reader_read(reader, text, length) != 0) {
+		free(text);
+		return NULL;
+	}
+	text[length] = '\0';
+	return text;
+}
+
+/**
+ * Helper function to decode a CBOR data item into a json object
+ * @param reader reader to read from
+ * @param depth current nesting depth
+ * @param item where to store the decoded json object, json null is stored as NULL
+ * @return 0 on success, otherwise -1 on error
+ */
+int cbor_read_item(struct storage_reader * reader, int depth, struct json_object ** item) {
+	int major, info;
+	uint64_t argument, key_length, i;
+	uint32_t bits32;
+	float value32;
+	double value64;
+	char * text;
+	struct json_object * child;
+
+	*item = NULL;
+	if (depth > CBOR_MAX_DEPTH) {
+		fprintf(stderr, "CBOR data is nested too deeply\n");
+		return -1;
+	}
+	if (cbor_read_head(reader, &major, &info, &argument) != 0) return -1;
+
+	switch (major) {
+		case CBOR_UINT:
+			*item = argument > INT64_MAX ? json_object_new_uint64(argument) : json_object_new_int64((int64_t) argument);
+			return 0;
+		case CBOR_NEGINT:
+			if (argument > INT64_MAX) {
+				fprintf(stderr, "CBOR integer is out of range\n");
+				return -1;
+			}
+			*item = json_object_new_int64(-1 - (int64_t) argument);
+			return 0;
+		case CBOR_TEXT:
+			text = cbor_read_text(reader, argument);
+			if (text == NULL) return -1;
+			*item = json_object_new_string_len(text, (int) argument);
+			free(text);
+			return 0;
+		case CBOR_ARRAY:
+			*item = json_object_new_array_ext(argument < 1024 ? (int) argument : 1024);
+			for (i=0; i<argument; i++) {
+				if (cbor_read_item(reader, depth + 1, &child) != 0) {
+					json_object_put(*item);
+					*item = NULL;
+					return -1;
+				}
+				json_object_array_add(*item, child);
+			}
+			return 0;
+		case CBOR_MAP:
+			*item = json_object_new_object();
+			for (i=0; i<argument; i++) {
+				if (cbor_read_head(reader, &major, &info, &key_length) != 0 || major != CBOR_TEXT) {
+					fprintf(stderr, "CBOR map keys must be strings\n");
+					json_object_put(*item);
+					*item = NULL;
+					return -1;
+				}
+				text = cbor_read_text(reader, key_length);
+				if (text == NULL || cbor_read_item(reader, depth + 1, &child) != 0) {
+					free(text);
+					json_object_put(*item);
+					*item = NULL;
+					return -1;
+				}
+				json_object_object_add(*item, text, child);
+				free(text);
+			}
+			return 0;
+		case CBOR_TAG:
+			// tags carry no meaning for the anime array, decode the tagged item as is
+			return cbor_read_item(reader, depth + 1, item);
+		case CBOR_SIMPLE:
+			switch (info) {
+				case 20:
+					*item = json_object_new_boolean(0);
+					return 0;
+				case 21:
+					*item = json_object_new_boolean(1);
+					return 0;
+				case 22:
+					return 0;
+				case 25: // half precision
+					if ((argument & 0x7c00) == 0x7c00) {
+						value64 = (argument & 0x3ff) ? NAN : INFINITY;
+					} else if ((argument & 0x7c00) == 0) {
+						value64 = ldexp((double) (argument & 0x3ff), -24);
+					} else {
+						value64 = ldexp((double) ((argument & 0x3ff) | 0x400), (int) ((argument >> 10) & 0x1f) - 25);
+					}
+					*item = json_object_new_double((argument & 0x8000) ? -value64 : value64);
+					return 0;
+				case 26:
+					bits32 = (uint32_t) argument;
+					memcpy(&value32, &bits32, sizeof(value32));
+					*item = json_object_new_double(value32);
+					return 0;
+				case 27:
+					memcpy(&value64, &argument, sizeof(value64));
+					*item = json_object_new_double(value64);
+					return 0;
+				default:
+					break;
+			}
+			break;
+		default:
+			break;
+	}
+
+	fprintf(stderr, "Unsupported CBOR data item\n");
+	return -1;
+}
+
+/**
+ * Read anime array from a file, detecting its storage format from magic bytes
+ * Data is decoded one buffer at a time as it is decompressed, the whole file is never held in memory
+ * @param file file to read from, opened with storage_open_read()
+ * @param format where to store the detected format
+ * @return json object read from the file, or NULL on error
+ */
+struct json_object * storage_read(gzFile file, struct storage_format * format) {
+	int read;
+	struct json_object * object = NULL;
+	struct storage_reader * reader = malloc(sizeof(struct storage_reader));
+	if (reader == NULL) return NULL;
+	reader->file = file;
+	reader->at = 0;
+	reader->length = 0;
+	PROBE0(parse__start);
+
+	// an empty file is left for the json parser to reject
+	while (reader->length < sizeof(cbor_magic)) {
+		read = gzread(file, reader->buffer + reader->length, (unsigned) (STORAGE_BUFFER_SIZE - reader->length));
+		if (read <= 0) break;
+		reader->length += (size_t) read;
+	}
+	format->compressed = !gzdirect(file);
+
+	if (reader->length >= sizeof(cbor_magic) && memcmp(reader->buffer, cbor_magic, sizeof(cbor_magic)) == 0) {
+		format->encoding = STORAGE_CBOR;
+		cbor_read_item(reader, 0, &object);
+	} else {
+		format->encoding = STORAGE_JSON;
+		object = json_read(reader);
+	}
+
+	free(reader);
+	PROBE3(parse__done, format->encoding, PROBE_ENABLED(parse__done) ? gztell(file) : 0,
+		   !json_object_is_type(object, json_type_array) ? -1 : PROBE_ENABLED(parse__done) ? (int) json_object_array_length(object) : 0);
+	return object;
+}
+
+/**
+ * Helper function to write the head of a CBOR data item using the shortest encoding
+ * @param file file to write to
+ * @param major major type
+ * @param argument argument (length or value)
+ */
+void cbor_write_head(gzFile file, int major, uint64_t argument) {
+	unsigned char head[9];
+	size_t i, length;
+
+	if (argument < 24) {
+		gzputc(file, (major << 5) | (int) argument);
+		return;
+	}
+
+	if (argument <= UINT8_MAX) length = 1;
+	else if (argument <= UINT16_MAX) length = 2;
+	else if (argument <= UINT32_MAX) length = 4;
+	else length = 8;
+
+	head[0] = (unsigned char) ((major << 5) | (length == 1 ? 24 : length == 2 ? 25 : length == 4 ? 26 : 27));
+	for (i=length; i>0; i--) {
+		head[i] = (unsigned char) (argument & 0xff);
+		argument >>= 8;
+	}
+	gzwrite(file, head, (unsigned) (length + 1));
+}
+
+/**
+ * Helper function to encode a json object as a CBOR data item
+ * @param file file to write to
+ * @param object json object to encode
+ */
+void cbor_write_item(gzFile file, struct json_object * object) {
+	size_t i, length;
+	int64_t value;
+	double value64;
+	uint64_t bits;
+	const char * key;
+	struct json_object_iterator iterator;
+	struct json_object_iterator iterator_end;
+
+	switch (json_object_get_type(object)) {
+		case json_type_null:
+			gzputc(file, (CBOR_SIMPLE << 5) | 22);
+			break;
+		case json_type_boolean:
+			gzputc(file, (CBOR_SIMPLE << 5) | (json_object_get_boolean(object) ? 21 : 20));
+			break;
+		case json_type_int:
+			value = json_object_get_int64(object);
+			if (value < 0) {
+				cbor_write_head(file, CBOR_NEGINT, (uint64_t) (-1 - value));
+			} else {
+				cbor_write_head(file, CBOR_UINT, json_object_get_uint64(object));
+			}
+			break;
+		case json_type_double:
+			value64 = json_object_get_double(object);
+			memcpy(&bits, &value64, sizeof(bits));
+			gzputc(file, (CBOR_SIMPLE << 5) | 27);
+			for (i=0; i<8; i++) gzputc(file, (int) ((bits >> (56 - 8*i)) & 0xff));
+			break;
+		case json_type_string:
+			length = (size_t) json_object_get_string_len(object);
+			cbor_write_head(file, CBOR_TEXT, length);
+			gzwrite(file, json_object_get_string(object), (unsigned) length);
+			break;
+		case json_type_array:
+			length = json_object_array_length(object);
+			cbor_write_head(file, CBOR_ARRAY, length);
+			for (i=0; i<length; i++) cbor_write_item(file, json_object_array_get_idx(object, i));
+			break;
+		case json_type_object:
+			cbor_write_head(file, CBOR_MAP, (uint64_t) json_object_object_length(object));
+			iterator = json_object_iter_begin(object);
+			iterator_end = json_object_iter_end(object);
+			while (!json_object_iter_equal(&iterator, &iterator_end)) {
+				key = json_object_iter_peek_name(&iterator);
+				length = strlen(key);
+				cbor_write_head(file, CBOR_TEXT, length);
+				gzwrite(file, key, (unsigned) length);
+				cbor_write_item(file, json_object_iter_peek_value(&iterator));
+				json_object_iter_next(&iterator);
+			}
+			break;
+	}
+}
+
+/**
+ * Helper function to write indentation for pretty printed json
+ * @param file file to write to
+ * @param level nesting level
+ */
+void json_write_indent(gzFile file, int level) {
+	static const char spaces[] = "                                ";
+	size_t length = (size_t) level * JSON_INDENT_WIDTH;
+
+	while (length > 0) {
+		size_t chunk = length < sizeof(spaces) - 1 ? length : sizeof(spaces) - 1;
+		gzwrite(file, spaces, (unsigned) chunk);
+		length -= chunk;
+	}
+}
+
+/**
+ * Helper function to write a json string with the same escaping json-c uses
+ * @param file file to write to
+ * @param string string to write
+ * @param length string length in bytes
+ */
+void json_write_string(gzFile file, const char * string, size_t length) {
+	static const char hex[] = "0123456789abcdef";
+	char escaped[6] = {'\\', 'u', '0', '0'};
+	size_t i, start = 0;
+	unsigned char c;
+
+	gzputc(file, '"');
+	for (i=0; i<length; i++) {
+		c = (unsigned char) string[i];
+		if (c >= ' ' && c != '"' && c != '\\' && c != '/') continue;
+
+		gzwrite(file, string + start, (unsigned) (i - start));
+		start = i + 1;
+		switch (c) {
+			case '\b':
+				gzputs(file, "\\b");
+				break;
+			case '\n':
+				gzputs(file, "\\n");
+				break;
+			case '\r':
+				gzputs(file, "\\r");
+				break;
+			case '\t':
+				gzputs(file, "\\t");
+				break;
+			case '\f':
+				gzputs(file, "\\f");
+				break;
+			case '"':
+				gzputs(file, "\\\"");
+				break;
+			case '\\':
+				gzputs(file, "\\\\");
+				break;
+			case '/':
+				gzputs(file, "\\/");
+				break;
+			default:
+				escaped[4] = hex[c >> 4];
+				escaped[5] = hex[c & 0xf];
+				gzwrite(file, escaped, sizeof(escaped));
+				break;
+		}
+	}
+	gzwrite(file, string + start, (unsigned) (length - start));
+	gzputc(file, '"');
+}
+
+/**
+ * Helper function to write a json object pretty printed the same way json-c does,
+ * without building the whole text in memory first
+ * @param file file to write to
+ * @param object json object to write
+ * @param level nesting level
+ */
+void json_write_item(gzFile file, struct json_object * object, int level) {
+	size_t i, length;
+	int64_t value;
+	const char * key;
+	struct json_object_iterator iterator;
+	struct json_object_iterator iterator_end;
+
+	switch (json_object_get_type(object)) {
+		case json_type_null:
+			gzputs(file, "null");
+			break;
+		case json_type_boolean:
+			gzputs(file, json_object_get_boolean(object) ? "true" : "false");
+			break;
+		case json_type_int:
+			value = json_object_get_int64(object);
+			if (value < 0) {
+				gzprintf(file, "%" PRId64, value);
+			} else {
+				gzprintf(file, "%" PRIu64, json_object_get_uint64(object));
+			}
+			break;
+		case json_type_double:
+			// doubles follow json-c's own formatting rules, they are rare enough to go through it
+			gzputs(file, json_object_to_json_string_ext(object, JSON_C_TO_STRING_PLAIN));
+			break;
+		case json_type_string:
+			json_write_string(file, json_object_get_string(object), (size_t) json_object_get_string_len(object));
+			break;
+		case json_type_array:
+			gzputs(file, "[\n");
+			length = json_object_array_length(object);
+			for (i=0; i<length; i++) {
+				if (i > 0) gzputs(file, ",\n");
+				json_write_indent(file, level + 1);
+				json_write_item(file, json_object_array_get_idx(object, i), level + 1);
+			}
+			if (length > 0) gzputc(file, '\n');
+			json_write_indent(file, level);
+			gzputc(file, ']');
+			break;
+		case json_type_object:
+			gzputs(file, "{\n");
+			iterator = json_object_iter_begin(object);
+			iterator_end = json_object_iter_end(object);
+			i = 0;
+			while (!json_object_iter_equal(&iterator, &iterator_end)) {
+				if (i++ > 0) gzputs(file, ",\n");
+				json_write_indent(file, level + 1);
+				key = json_object_iter_peek_name(&iterator);
+				json_write_string(file, key, strlen(key));
+				gzputs(file, ": ");
+				json_write_item(file, json_object_iter_peek_value(&iterator), level + 1);
+				json_object_iter_next(&iterator);
+			}
+			if (i > 0) gzputc(file, '\n');
+			json_write_indent(file, level);
+			gzputc(file, '}');
+			break;
+	}
+}
+
+/**
+ * Write anime array to a file in the given storage format
+ * Data is compressed as it is encoded, the whole uncompressed text is never held in memory
+ * @param file file to write to, opened with storage_open_write()
+ * @param anime_array anime array to write
+ * @param format storage format to use
+ * @return 0 on success, otherwise -1 on error
+ */
+int storage_write(gzFile file, struct json_object * anime_array, struct storage_format format) {
+	int error;
+
+	if (format.encoding == STORAGE_CBOR) {
+		gzwrite(file, cbor_magic, sizeof(cbor_magic));
+		cbor_write_item(file, anime_array);
+	} else {
+		json_write_item(file, anime_array, 0);
+	}
+
+	gzerror(file, &error);
+	if (error != Z_OK) {
+		fprintf(stderr, "Failed to write anime information into the file\n");
+		return -1;
+	}
+	return 0;
+}
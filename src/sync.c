@@ -0,0 +1,356 @@
+#include <json.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../include/anime_functions.h"
+#include "../include/sync.h"
+
+/**
+ * Fields merged when synchronizing, fields not listed here are kept as they are locally
+ */
+static const char * sync_fields[] = {"name", "episodes", "episodes_downloaded", "start_date", "delayed_episodes", "ignored"};
+
+/**
+ * Helper function to index anime by the value of a string field, the first anime wins on duplicates
+ * @param anime_array anime array to index
+ * @param key field to index by, anime without it are skipped
+ * @return json object mapping field values to anime indices, or NULL on error
+ */
+struct json_object * sync_index(struct json_object * anime_array, const char * key) {
+	size_t i, n_anime;
+	struct json_object * index;
+	struct json_object * value;
+
+	index = json_object_new_object();
+	if (index == NULL) return NULL;
+
+	n_anime = json_object_array_length(anime_array);
+	for (i=0; i<n_anime; i++) {
+		if (!json_object_object_get_ex(json_object_array_get_idx(anime_array, i), key, &value)) continue;
+		if (json_object_object_get_ex(index, json_object_get_string(value), NULL)) continue;
+		if (json_object_object_add(index, json_object_get_string(value), json_object_new_int64(i)) != 0) {
+			json_object_put(index);
+			return NULL;
+		}
+	}
+	return index;
+}
+
+/**
+ * Helper function to look up an anime in an index
+ * @param anime_array indexed anime array
+ * @param index index made with sync_index()
+ * @param key value to look up
+ * @return the anime, or NULL if there is none
+ */
+struct json_object * sync_lookup(struct json_object * anime_array, struct json_object * index, const char * key) {
+	struct json_object * at;
+
+	if (index == NULL || !json_object_object_get_ex(index, key, &at)) return NULL;
+	return json_object_array_get_idx(anime_array, json_object_get_int64(at));
+}
+
+/**
+ * Helper function to give an id to every anime of one side that does not have one yet
+ * @param anime_array anime array to assign ids in
+ * @param peer_array anime array of the other side, matching anime without an id get the new id too
+ * @param assigned number of anime given an id in anime_array, updated
+ * @param peer_assigned number of anime given an id in peer_array, updated
+ * @return 0 on success, otherwise -1 on error
+ */
+int sync_assign_side_uids(struct json_object * anime_array, struct json_object * peer_array, size_t * assigned, size_t * peer_assigned) {
+	size_t i, n_anime;
+	char uid[ANIME_UID_LENGTH + 1];
+	struct json_object * anime;
+	struct json_object * anime_name;
+	struct json_object * peer;
+	struct json_object * peer_uid;
+	struct json_object * uids = sync_index(anime_array, "uid");
+	struct json_object * peer_names = sync_index(peer_array, "name");
+
+	if (uids == NULL || peer_names == NULL) {
+		json_object_put(uids);
+		json_object_put(peer_names);
+		return -1;
+	}
+
+	n_anime = json_object_array_length(anime_array);
+	for (i=0; i<n_anime; i++) {
+		anime = json_object_array_get_idx(anime_array, i);
+		if (json_object_object_get_ex(anime, "uid", NULL)) continue;
+		if (!json_object_object_get_ex(anime, "name", &anime_name)) {
+			fprintf(stderr, "Malformed json\n");
+			json_object_put(uids);
+			json_object_put(peer_names);
+			return -1;
+		}
+
+		peer = sync_lookup(peer_array, peer_names, json_object_get_string(anime_name));
+		if (peer != NULL && json_object_object_get_ex(peer, "uid", &peer_uid)
+			&& !json_object_object_get_ex(uids, json_object_get_string(peer_uid), NULL)) {
+			snprintf(uid, sizeof(uid), "%s", json_object_get_string(peer_uid));
+		} else if (make_anime_uid(uid) != 0) {
+			json_object_put(uids);
+			json_object_put(peer_names);
+			return -1;
+		} else if (peer != NULL && !json_object_object_get_ex(peer, "uid", NULL)) {
+			json_object_object_add(peer, "uid", json_object_new_string(uid));
+			(*peer_assigned)++;
+		}
+		json_object_object_del(peer_names, json_object_get_string(anime_name)); // a peer anime is matched only once
+		json_object_object_add(anime, "uid", json_object_new_string(uid));
+		json_object_object_add(uids, uid, json_object_new_int64(i));
+		(*assigned)++;
+	}
+
+	json_object_put(uids);
+	json_object_put(peer_names);
+	return 0;
+}
+
+/**
+ * Give an id to every anime that does not have one yet
+ * Anime saved before ids existed are matched with the other side's anime by name, so both sides end up with the same id
+ * @param local_array local anime array
+ * @param other_array anime array of the other side
+ * @param local_assigned where to store the number of local anime given an id
+ * @param other_assigned where to store the number of anime of the other side given an id
+ * @return 0 on success, otherwise -1 on error
+ */
+int sync_assign_uids(struct json_object * local_array, struct json_object * other_array, size_t * local_assigned, size_t * other_assigned) {
+	*local_assigned = 0;
+	*other_assigned = 0;
+	if (sync_assign_side_uids(local_array, other_array, local_assigned, other_assigned) != 0) return -1;
+	return sync_assign_side_uids(other_array, local_array, other_assigned, local_assigned);
+}
+
+/**
+ * Helper function to get the time an anime field was last changed
+ * @param anime anime json object
+ * @param field field name
+ * @return unix time of the last change, 0 if it was never changed since the anime was added
+ */
+int64_t sync_field_version(struct json_object * anime, const char * field) {
+	struct json_object * versions;
+	struct json_object * version;
+
+	if (!json_object_object_get_ex(anime, "versions", &versions)) return 0;
+	if (!json_object_object_get_ex(versions, field, &version)) return 0;
+	return json_object_get_int64(version);
+}
+
+/**
+ * Helper function to merge one anime changed on both sides
+ * Fields changed on one side only are taken from that side, downloaded episodes count keeps the bigger value,
+ * other conflicting fields are resolved by last writer wins
+ * @param base anime at the last synchronization, or NULL if it was added on both sides since
+ * @param local local anime
+ * @param other anime of the other side
+ * @return merged anime, or NULL on error
+ */
+struct json_object * sync_merge_anime(struct json_object * base, struct json_object * local, struct json_object * other) {
+	size_t i;
+	int64_t local_version, other_version;
+	struct json_object * merged = NULL;
+	struct json_object * versions;
+	struct json_object * local_value;
+	struct json_object * other_value;
+	struct json_object * base_value;
+	struct json_object * value;
+
+	if (json_object_deep_copy(local, &merged, NULL) != 0) return NULL;
+	versions = json_object_new_object();
+	if (versions == NULL || json_object_object_add(merged, "versions", versions) != 0) {
+		json_object_put(merged);
+		return NULL;
+	}
+
+	for (i=0; i<sizeof(sync_fields)/sizeof(sync_fields[0]); i++) {
+		if (!json_object_object_get_ex(local, sync_fields[i], &local_value)
+			|| !json_object_object_get_ex(other, sync_fields[i], &other_value)) {
+			fprintf(stderr, "Malformed json\n");
+			json_object_put(merged);
+			return NULL;
+		}
+		local_version = sync_field_version(local, sync_fields[i]);
+		other_version = sync_field_version(other, sync_fields[i]);
+		if (base == NULL || !json_object_object_get_ex(base, sync_fields[i], &base_value)) base_value = NULL;
+
+		if (json_object_equal(local_value, other_value)) {
+			value = local_value;
+		} else if (strcmp(sync_fields[i], "episodes_downloaded") == 0) {
+			value = json_object_get_uint64(local_value) >= json_object_get_uint64(other_value) ? local_value : other_value;
+		} else if (base_value != NULL && json_object_equal(local_value, base_value)) {
+			value = other_value;
+		} else if (base_value != NULL && json_object_equal(other_value, base_value)) {
+			value = local_value;
+		} else {
+			value = other_version > local_version ? other_value : local_value; // ties keep the local value
+		}
+
+		if (value == other_value) json_object_object_add(merged, sync_fields[i], json_object_get(other_value));
+		if (local_version != 0 || other_version != 0) {
+			json_object_object_add(versions, sync_fields[i], json_object_new_int64(local_version > other_version ? local_version : other_version));
+		}
+	}
+
+	if (json_object_object_length(versions) == 0) json_object_object_del(merged, "versions");
+	return merged;
+}
+
+/**
+ * Helper function to count how a side changes when it takes the merged anime
+ * @param changes changes of the side
+ * @param before anime on the side before merging, or NULL if the side does not have it
+ * @param after merged anime, or NULL if it is removed
+ */
+void sync_count_change(struct sync_changes * changes, struct json_object * before, struct json_object * after) {
+	if (before == NULL && after != NULL) {
+		changes->added++;
+	} else if (before != NULL && after == NULL) {
+		changes->removed++;
+	} else if (before != NULL && !json_object_equal(before, after)) {
+		changes->updated++;
+	}
+}
+
+/**
+ * Anime array of one synchronized side, indexed by id
+ */
+struct sync_side {
+	struct json_object * array;
+	struct json_object * uids;
+};
+
+/**
+ * Helper function to get the id of an anime
+ * @param anime anime json object
+ * @return the id, or NULL if the anime does not have one
+ */
+const char * sync_anime_uid(struct json_object * anime) {
+	struct json_object * anime_uid;
+
+	if (!json_object_object_get_ex(anime, "uid", &anime_uid)) {
+		fprintf(stderr, "Anime without an id\n");
+		return NULL;
+	}
+	return json_object_get_string(anime_uid);
+}
+
+/**
+ * Helper function to merge anime the local side has, in local order
+ * @param merged_array array to append merged anime to
+ * @param base last synchronized side
+ * @param local local side
+ * @param other other side
+ * @param local_changes changes the local side has to apply, updated
+ * @param other_changes changes the other side has to apply, updated
+ * @return 0 on success, otherwise -1 on error
+ */
+int sync_merge_local(struct json_object * merged_array, const struct sync_side * base, const struct sync_side * local, const struct sync_side * other,
+					 struct sync_changes * local_changes, struct sync_changes * other_changes) {
+	size_t i, n_anime;
+	const char * uid;
+	struct json_object * local_anime;
+	struct json_object * other_anime;
+	struct json_object * base_anime;
+	struct json_object * merged;
+
+	n_anime = json_object_array_length(local->array);
+	for (i=0; i<n_anime; i++) {
+		local_anime = json_object_array_get_idx(local->array, i);
+		uid = sync_anime_uid(local_anime);
+		if (uid == NULL) return -1;
+		base_anime = sync_lookup(base->array, base->uids, uid);
+		other_anime = sync_lookup(other->array, other->uids, uid);
+
+		if (other_anime != NULL) {
+			merged = sync_merge_anime(base_anime, local_anime, other_anime);
+			if (merged == NULL) return -1;
+		} else if (base_anime != NULL && json_object_equal(local_anime, base_anime)) {
+			merged = NULL; // removed on the other side and unchanged locally
+		} else {
+			merged = json_object_get(local_anime); // added locally, or changed locally after removal on the other side
+		}
+
+		sync_count_change(local_changes, local_anime, merged);
+		sync_count_change(other_changes, other_anime, merged);
+		if (merged != NULL) json_object_array_add(merged_array, merged);
+	}
+	return 0;
+}
+
+/**
+ * Helper function to merge anime only the other side has
+ * @param merged_array array to append merged anime to
+ * @param base last synchronized side
+ * @param local local side
+ * @param other other side
+ * @param local_changes changes the local side has to apply, updated
+ * @param other_changes changes the other side has to apply, updated
+ * @return 0 on success, otherwise -1 on error
+ */
+int sync_merge_other(struct json_object * merged_array, const struct sync_side * base, const struct sync_side * local, const struct sync_side * other,
+					 struct sync_changes * local_changes, struct sync_changes * other_changes) {
+	size_t i, n_anime;
+	const char * uid;
+	struct json_object * other_anime;
+	struct json_object * base_anime;
+	struct json_object * merged;
+
+	n_anime = json_object_array_length(other->array);
+	for (i=0; i<n_anime; i++) {
+		other_anime = json_object_array_get_idx(other->array, i);
+		uid = sync_anime_uid(other_anime);
+		if (uid == NULL) return -1;
+		if (sync_lookup(local->array, local->uids, uid) != NULL) continue;
+		base_anime = sync_lookup(base->array, base->uids, uid);
+
+		if (base_anime != NULL && json_object_equal(other_anime, base_anime)) {
+			merged = NULL; // removed locally and unchanged on the other side
+		} else {
+			merged = json_object_get(other_anime); // added on the other side, or changed there after local removal
+		}
+
+		sync_count_change(local_changes, NULL, merged);
+		sync_count_change(other_changes, other_anime, merged);
+		if (merged != NULL) json_object_array_add(merged_array, merged);
+	}
+	return 0;
+}
+
+/**
+ * Three-way merge of two anime arrays against their state at the last synchronization
+ * Anime are matched by id, so every anime must have one, see sync_assign_uids().
+ * Anime removed on one side are removed from the result unless the other side changed them since,
+ * anime present on both sides are merged field by field, see sync_merge_anime().
+ * The result keeps the local order, with anime added on the other side appended.
+ * @param base_array anime array at the last synchronization, empty if the sides were never synchronized
+ * @param local_array local anime array
+ * @param other_array anime array of the other side
+ * @param local_changes where to store the changes the local side has to apply
+ * @param other_changes where to store the changes the other side has to apply
+ * @return merged anime array, or NULL on error
+ */
+struct json_object * sync_merge(struct json_object * base_array, struct json_object * local_array, struct json_object * other_array,
+								struct sync_changes * local_changes, struct sync_changes * other_changes) {
+	struct json_object * merged_array = json_object_new_array();
+	struct sync_side base = {base_array, sync_index(base_array, "uid")};
+	struct sync_side local = {local_array, sync_index(local_array, "uid")};
+	struct sync_side other = {other_array, sync_index(other_array, "uid")};
+
+	memset(local_changes, 0, sizeof(struct sync_changes));
+	memset(other_changes, 0, sizeof(struct sync_changes));
+	if (merged_array == NULL || base.uids == NULL || local.uids == NULL || other.uids == NULL
+		|| sync_merge_local(merged_array, &base, &local, &other, local_changes, other_changes) != 0
+		|| sync_merge_other(merged_array, &base, &local, &other, local_changes, other_changes) != 0) {
+		json_object_put(merged_array);
+		merged_array = NULL;
+	}
+
+	json_object_put(base.uids);
+	json_object_put(local.uids);
+	json_object_put(other.uids);
+	return merged_array;
+}
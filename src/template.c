@@ -0,0 +1,363 @@
+#include <json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/anime_functions.h"
+#include "../include/template.h"
+
+#define TEMPLATE_SECTION_NAME "items"
+
+/**
+ * Information about a single new episode used to fill item placeholders
+ */
+struct template_item {
+	size_t anime_at;
+	const char * name;
+	size_t episode;
+	size_t new_episodes;
+	size_t downloaded;
+	size_t episodes;
+};
+
+/**
+ * Helper function to look up a placeholder by its name
+ * @param name placeholder name, not null terminated
+ * @param name_len length of the placeholder name
+ * @param field where to store the field the placeholder refers to
+ * @return 0 on success, otherwise -1 if no such placeholder exists
+ */
+int template_lookup_field(const char * name, size_t name_len, enum TEMPLATE_FIELD * field) {
+	static const struct {
+		const char * name;
+		enum TEMPLATE_FIELD field;
+	} fields[] = {
+		{"count", FIELD_COUNT},
+		{"anime", FIELD_ANIME},
+		{"id", FIELD_ID},
+		{"name", FIELD_NAME},
+		{"episode", FIELD_EPISODE},
+		{"new", FIELD_NEW},
+		{"downloaded", FIELD_DOWNLOADED},
+		{"episodes", FIELD_EPISODES},
+	};
+	size_t i;
+
+	for (i=0; i<sizeof(fields)/sizeof(fields[0]); i++) {
+		if (strlen(fields[i].name) == name_len && memcmp(fields[i].name, name, name_len) == 0) {
+			*field = fields[i].field;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Compile a user output template into an opcode list
+ * Placeholders are written as {field}, the part between {#items} and {/items} is repeated for every new episode,
+ * the part between {^items} and {/items} is only printed if there are no new episodes, {{ prints a literal '{'
+ * @param source template to compile
+ * @return compiled template, or NULL on error, must be freed with template_free()
+ */
+struct template * template_compile(const char * source) {
+	size_t i, source_len, max_ops, text_start, name_len;
+	size_t section_at = 0;
+	int in_section = 0;
+	const char * name;
+	const char * name_end;
+	struct template * tmpl;
+	struct template_op * op;
+
+	// every '{' splits the template into at most one literal and one placeholder
+	source_len = strlen(source);
+	max_ops = 1;
+	for (i=0; i<source_len; i++) {
+		if (source[i] == '{') max_ops += 2;
+	}
+
+	tmpl = malloc(sizeof(struct template) + max_ops * sizeof(struct template_op));
+	if (tmpl == NULL) return NULL;
+	tmpl->n_ops = 0;
+	tmpl->source = strdup(source);
+	if (tmpl->source == NULL) {
+		free(tmpl);
+		return NULL;
+	}
+
+	text_start = 0;
+	i = 0;
+	while (i < source_len) {
+		if (source[i] != '{') {
+			i++;
+			continue;
+		}
+
+		// flush literal text preceding the brace, an escaped brace is kept as part of it
+		if (source[i+1] == '{') {
+			op = &tmpl->ops[tmpl->n_ops++];
+			op->op = TEMPLATE_TEXT;
+			op->offset = text_start;
+			op->length = i + 1 - text_start;
+			i += 2;
+			text_start = i;
+			continue;
+		}
+		if (i > text_start) {
+			op = &tmpl->ops[tmpl->n_ops++];
+			op->op = TEMPLATE_TEXT;
+			op->offset = text_start;
+			op->length = i - text_start;
+		}
+
+		name = source + i + 1;
+		name_end = strchr(name, '}');
+		if (name_end == NULL) {
+			fprintf(stderr, "Unterminated placeholder in template at position %zu\n", i+1);
+			template_free(tmpl);
+			return NULL;
+		}
+		name_len = name_end - name;
+
+		op = &tmpl->ops[tmpl->n_ops];
+		if ((name[0] == '#' || name[0] == '^' || name[0] == '/')
+				&& name_len - 1 == strlen(TEMPLATE_SECTION_NAME)
+				&& memcmp(name + 1, TEMPLATE_SECTION_NAME, name_len - 1) == 0) {
+			if (name[0] == '/') {
+				if (!in_section) {
+					fprintf(stderr, "Closing a section that was never opened in template at position %zu\n", i+1);
+					template_free(tmpl);
+					return NULL;
+				}
+				op->op = TEMPLATE_SECTION_END;
+				tmpl->ops[section_at].end = tmpl->n_ops;
+				in_section = 0;
+			} else {
+				if (in_section) {
+					fprintf(stderr, "Nested sections are not supported in template at position %zu\n", i+1);
+					template_free(tmpl);
+					return NULL;
+				}
+				op->op = name[0] == '#' ? TEMPLATE_ITEMS_BEGIN : TEMPLATE_EMPTY_BEGIN;
+				section_at = tmpl->n_ops;
+				in_section = 1;
+			}
+		} else {
+			if (template_lookup_field(name, name_len, &op->field) != 0) {
+				fprintf(stderr, "Unknown template placeholder '%.*s'\n", (int) name_len, name);
+				template_free(tmpl);
+				return NULL;
+			}
+			op->op = TEMPLATE_FIELD;
+		}
+		tmpl->n_ops++;
+
+		i += name_len + 2;
+		text_start = i;
+	}
+
+	if (in_section) {
+		fprintf(stderr, "Unterminated section in template\n");
+		template_free(tmpl);
+		return NULL;
+	}
+
+	if (source_len > text_start) {
+		op = &tmpl->ops[tmpl->n_ops++];
+		op->op = TEMPLATE_TEXT;
+		op->offset = text_start;
+		op->length = source_len - text_start;
+	}
+
+	return tmpl;
+}
+
+/**
+ * Free a compiled template
+ * @param tmpl template to free, may be NULL
+ */
+void template_free(struct template * tmpl) {
+	if (tmpl == NULL) return;
+	free(tmpl->source);
+	free(tmpl);
+}
+
+/**
+ * Helper function to print an unsigned number without going through printf
+ * @param number number to print
+ */
+void template_put_number(size_t number) {
+	char buffer[24];
+	size_t at = sizeof(buffer);
+
+	do {
+		buffer[--at] = (char) ('0' + number % 10);
+		number /= 10;
+	} while (number != 0);
+
+	fwrite(buffer + at, sizeof(char), sizeof(buffer) - at, stdout);
+}
+
+/**
+ * Helper function to execute a range of template opcodes
+ * @param tmpl compiled template
+ * @param from index of the first opcode to execute
+ * @param to index of the opcode to stop at
+ * @param item new episode to use for item placeholders, or NULL to leave them empty
+ * @param count total number of new episodes
+ * @param anime number of anime with new episodes
+ */
+void template_execute(const struct template * tmpl, size_t from, size_t to, const struct template_item * item,
+					  size_t count, size_t anime) {
+	size_t i;
+	const struct template_op * op;
+
+	for (i=from; i<to; i++) {
+		op = &tmpl->ops[i];
+		if (op->op == TEMPLATE_TEXT) {
+			fwrite(tmpl->source + op->offset, sizeof(char), op->length, stdout);
+			continue;
+		}
+		if (op->op != TEMPLATE_FIELD) continue;
+
+		switch (op->field) {
+			case FIELD_COUNT:
+				template_put_number(count);
+				break;
+			case FIELD_ANIME:
+				template_put_number(anime);
+				break;
+			default:
+				if (item == NULL) break;
+				switch (op->field) {
+					case FIELD_ID:
+						template_put_number(item->anime_at + 1);
+						break;
+					case FIELD_NAME:
+						fputs(item->name, stdout);
+						break;
+					case FIELD_EPISODE:
+						template_put_number(item->episode);
+						break;
+					case FIELD_NEW:
+						template_put_number(item->new_episodes);
+						break;
+					case FIELD_DOWNLOADED:
+						template_put_number(item->downloaded);
+						break;
+					case FIELD_EPISODES:
+						template_put_number(item->episodes);
+						break;
+					default:
+						break;
+				}
+				break;
+		}
+	}
+}
+
+/**
+ * Helper function to fill item information for an anime with new episodes
+ * @param anime_array json_object, must be of type json_type_array
+ * @param anime_at index of the anime
+ * @param new_episodes number of new episodes for the anime
+ * @param item where to store the information, episode is set to the first new episode
+ * @return -1 on error, otherwise 0
+ */
+int template_fill_item(struct json_object * anime_array, size_t anime_at, size_t new_episodes,
+					   struct template_item * item) {
+	struct json_object * anime;
+	struct json_object * anime_name;
+	struct json_object * anime_episodes;
+	struct json_object * anime_episodes_downloaded;
+
+	anime = json_object_array_get_idx(anime_array, anime_at);
+	if (!json_object_object_get_ex(anime, "name", &anime_name)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	if (!json_object_object_get_ex(anime, "episodes", &anime_episodes)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+	if (!json_object_object_get_ex(anime, "episodes_downloaded", &anime_episodes_downloaded)) {
+		fprintf(stderr, "Malformed json\n");
+		return -1;
+	}
+
+	item->anime_at = anime_at;
+	item->name = json_object_get_string(anime_name);
+	item->new_episodes = new_episodes;
+	item->downloaded = json_object_get_uint64(anime_episodes_downloaded);
+	item->episodes = json_object_get_uint64(anime_episodes);
+	item->episode = item->downloaded + 1;
+	return 0;
+}
+
+/**
+ * Print new episodes information using a compiled template
+ * @param tmpl compiled template
+ * @param anime_array json_object, must be of type json_type_array
+ * @return -1 on error, otherwise 0
+ */
+int print_template(const struct template * tmpl, struct json_object * anime_array) {
+	size_t i, j, k, n_anime, count, anime;
+	int episodes_available;
+	int * new_episodes;
+	struct template_item first;
+	struct template_item item;
+	const struct template_op * op;
+
+	n_anime = json_object_array_length(anime_array);
+	new_episodes = malloc((n_anime + 1) * sizeof(int));
+	if (new_episodes == NULL) return -1;
+
+	// records are counted up front, summary placeholders may come before the items
+	count = 0;
+	anime = 0;
+	for (i=0; i<n_anime; i++) {
+		episodes_available = get_new_episodes_count(anime_array, i);
+		if (episodes_available < 0) {
+			free(new_episodes);
+			return -1;
+		}
+		new_episodes[i] = episodes_available;
+		if (episodes_available == 0) continue;
+		if (anime == 0 && template_fill_item(anime_array, i, episodes_available, &first) != 0) {
+			free(new_episodes);
+			return -1;
+		}
+		count += episodes_available;
+		anime++;
+	}
+
+	for (k=0; k<tmpl->n_ops; k++) {
+		op = &tmpl->ops[k];
+		switch (op->op) {
+			case TEMPLATE_ITEMS_BEGIN:
+				for (i=0; i<n_anime; i++) {
+					if (new_episodes[i] == 0) continue;
+					if (template_fill_item(anime_array, i, new_episodes[i], &item) != 0) {
+						free(new_episodes);
+						return -1;
+					}
+					for (j=0; j<(size_t) new_episodes[i]; j++) {
+						template_execute(tmpl, k+1, op->end, &item, count, anime);
+						item.episode++;
+					}
+				}
+				k = op->end;
+				break;
+			case TEMPLATE_EMPTY_BEGIN:
+				if (count == 0) template_execute(tmpl, k+1, op->end, NULL, count, anime);
+				k = op->end;
+				break;
+			default:
+				// item placeholders outside of a section refer to the first new episode
+				template_execute(tmpl, k, k+1, anime == 0 ? NULL : &first, count, anime);
+				break;
+		}
+	}
+	putchar('\n');
+
+	free(new_episodes);
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../include/utf8.h"
+
+/**
+ * Code point ranges that are not one column wide, sorted by first code point
+ * Zero width ranges are combining marks, two column ones East Asian wide and fullwidth characters
+ */
+static const struct {
+	uint32_t first, last;
+	int width;
+} utf8_width_ranges[] = {
+	{0x0300, 0x036F, 0}, {0x0483, 0x0489, 0}, {0x0591, 0x05BD, 0}, {0x0610, 0x061A, 0},
+	{0x064B, 0x065F, 0}, {0x1100, 0x115F, 2}, {0x1AB0, 0x1AFF, 0}, {0x1DC0, 0x1DFF, 0},
+	{0x200B, 0x200F, 0}, {0x20D0, 0x20FF, 0}, {0x231A, 0x231B, 2}, {0x2329, 0x232A, 2},
+	{0x2E80, 0x3098, 2}, {0x3099, 0x309A, 0}, {0x309B, 0x4DBF, 2}, {0x4E00, 0xA4CF, 2},
+	{0xA960, 0xA97F, 2}, {0xAC00, 0xD7A3, 2}, {0xF900, 0xFAFF, 2}, {0xFE00, 0xFE0F, 0},
+	{0xFE10, 0xFE19, 2}, {0xFE20, 0xFE2F, 0}, {0xFE30, 0xFE6F, 2}, {0xFF00, 0xFF60, 2},
+	{0xFFE0, 0xFFE6, 2}, {0x1F300, 0x1F64F, 2}, {0x1F900, 0x1F9FF, 2}, {0x20000, 0x2FFFD, 2},
+	{0x30000, 0x3FFFD, 2},
+};
+
+/**
+ * Count leading printable ASCII bytes, 16 bytes at a time with SSE2, otherwise 8 at a time
+ * @param s string to scan
+ * @param length number of bytes to scan at most
+ * @return number of leading bytes from 0x20 to 0x7E
+ */
+size_t utf8_printable_prefix(const char * s, size_t length) {
+	size_t at = 0;
+#ifdef __SSE2__
+	int mask;
+	__m128i bytes;
+
+	for (; at + 16 <= length; at += 16) {
+		bytes = _mm_loadu_si128((const __m128i *) (s + at));
+		// bytes from 0x80 up are negative, so the signed compare catches them along with control characters
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(bytes, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7F))));
+		if (mask != 0) return at + __builtin_ctz(mask);
+	}
+#else
+	uint64_t word, del;
+
+	for (; at + 8 <= length; at += 8) {
+		memcpy(&word, s + at, sizeof(word));
+		del = word ^ 0x7F7F7F7F7F7F7F7FULL; // bytes equal to 0x7F become 0
+		if ((word | ((word - 0x2020202020202020ULL) & ~word) | ((del - 0x0101010101010101ULL) & ~del)) & 0x8080808080808080ULL) {
+			break; // the scalar loop finds the exact byte
+		}
+	}
+#endif
+	while (at < length && (unsigned char) s[at] >= 0x20 && (unsigned char) s[at] < 0x7F) at++;
+	return at;
+}
+
+/**
+ * Decode and validate a single UTF-8 sequence
+ * Overlong encodings, surrogates and code points above U+10FFFF are rejected
+ * @param s string to decode from
+ * @param length number of bytes available
+ * @param codepoint where to store the decoded code point
+ * @return length of the sequence in bytes, or 0 if it is invalid
+ */
+size_t utf8_decode(const char * s, size_t length, uint32_t * codepoint) {
+	const unsigned char * bytes = (const unsigned char *) s;
+	size_t i, n;
+	uint32_t value, min;
+
+	if (length == 0) return 0;
+	if (bytes[0] < 0x80) {
+		*codepoint = bytes[0];
+		return 1;
+	} else if ((bytes[0] & 0xE0) == 0xC0) {
+		n = 2;
+		value = bytes[0] & 0x1F;
+		min = 0x80;
+	} else if ((bytes[0] & 0xF0) == 0xE0) {
+		n = 3;
+		value = bytes[0] & 0x0F;
+		min = 0x800;
+	} else if ((bytes[0] & 0xF8) == 0xF0) {
+		n = 4;
+		value = bytes[0] & 0x07;
+		min = 0x10000;
+	} else {
+		return 0;
+	}
+	if (length < n) return 0;
+
+	for (i=1; i<n; i++) {
+		if ((bytes[i] & 0xC0) != 0x80) return 0;
+		value = (value << 6) | (bytes[i] & 0x3F);
+	}
+	if (value < min || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) return 0;
+
+	*codepoint = value;
+	return n;
+}
+
+/**
+ * Get the number of terminal columns a code point takes
+ * @param codepoint code point
+ * @return 0 for combining marks, 2 for wide characters, otherwise 1
+ */
+int utf8_codepoint_width(uint32_t codepoint) {
+	size_t low = 0, high = sizeof(utf8_width_ranges) / sizeof(utf8_width_ranges[0]), middle;
+
+	if (codepoint < utf8_width_ranges[0].first) return 1;
+	while (low < high) {
+		middle = (low + high) / 2;
+		if (codepoint < utf8_width_ranges[middle].first) {
+			high = middle;
+		} else if (codepoint > utf8_width_ranges[middle].last) {
+			low = middle + 1;
+		} else {
+			return utf8_width_ranges[middle].width;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Print a string into a column, truncated and padded by display width instead of bytes
+ * A character is never cut in half, invalid sequences and control characters are printed as '?'
+ * @param stream stream to print to
+ * @param s string to print
+ * @param length length of the string in bytes
+ * @param columns width of the column
+ * @return display width of the printed part of the string, before padding
+ */
+size_t utf8_print_column(FILE * stream, const char * s, size_t length, size_t columns) {
+	size_t at = 0, span = 0, width = 0, run, n, i;
+	uint32_t codepoint;
+	int codepoint_width;
+
+	while (at < length && width < columns) {
+		// printable ASCII is one column per byte, so a whole run fits if it is short enough
+		run = utf8_printable_prefix(s + at, length - at < columns - width ? length - at : columns - width);
+		at += run;
+		width += run;
+		if (at == length || width == columns) break;
+
+		n = utf8_decode(s + at, length - at, &codepoint);
+		if (n == 0 || codepoint < 0x20 || (codepoint >= 0x7F && codepoint <= 0x9F)) {
+			// control characters would move the cursor or start escape sequences
+			fwrite(s + span, 1, at - span, stream);
+			fputc('?', stream);
+			width++;
+			at += n == 0 ? 1 : n;
+			span = at;
+			continue;
+		}
+		codepoint_width = utf8_codepoint_width(codepoint);
+		if (width + codepoint_width > columns) break;
+		at += n;
+		width += codepoint_width;
+	}
+	fwrite(s + span, 1, at - span, stream);
+
+	for (i=width; i<columns; i++) fputc(' ', stream);
+	return width;
+}